@@ -102,10 +102,21 @@ var api = (function () {
 		$("#statusRtpServer").val(status.server_state);
 		$("#statusRtp").val(
 			status.rtp_good + " / " + status.rtp_loss + " / "
-			+ status.rtp_error);
+			+ status.rtp_error + ", " + status.rtp_reordered
+			+ " reordered / " + status.rtp_recovered + " recovered / "
+			+ status.rtp_late + " late, " + status.udp_copied
+			+ " bytes copied from chained buffers");
 		$("#statusMjpeg").val(
 			status.mjpeg_good + " / " + status.mjpeg_loss + " / "
-			+ status.mjpeg_error);
+			+ status.mjpeg_error + ", " + status.mjpeg_partial
+			+ " partial, " + status.mjpeg_copied
+			+ " bytes copied per frame");
+		if (status.mjpeg_drop)
+			$("#statusMjpegDrop").val(
+				status.mjpeg_drop.ring_full + " ring full / "
+				+ status.mjpeg_drop.skipped + " skipped / "
+				+ status.mjpeg_drop.too_large + " too large / "
+				+ status.mjpeg_drop.no_memory + " no memory");
 		$("#statusArtnet").val(
 			status.artnet_good + " / " + status.artnet_loss + " / "
 			+ status.artnet_error);
@@ -122,6 +133,19 @@ var api = (function () {
 			$("#statusLed").val("");
 		}
 
+		var isr = "";
+		if (status.led_isr) {
+			for (var i = 0; i < status.led_isr.length; i++) {
+				var core = status.led_isr[i];
+				if (core.calls == 0)
+					continue;
+				isr += "core " + i + ": " + core.calls + " calls, "
+					+ Math.round(core.cycles / core.calls) + " cycles mean, "
+					+ core.max_cycles + " max, " + core.late + " late refills ";
+			}
+		}
+		$("#statusLedIsr").val(isr);
+
 		var res = "";
 		if (status.time >= 86400)
 			res += Math.floor(status.time / 86400) + " d ";
@@ -128,12 +128,15 @@ static void setDefaults() {
   led_config.prefix_leds = 0;
   led_config.refresh_rate = 10;
   for (int i = 0; i < led_get_max_lines(); i++) {
-    led_config.channel[i].mode = defaultModes[i];
+    led_config.channel[i].mode = defaultModes[i % sizeof(defaultModes)];
     led_config.channel[i].sx = led_config.channel[i].sy = 8;
     led_config.channel[i].ox = led_config.channel[i].oy = 0;
     led_config.channel[i].orientation = LED_ORI0_ZIGZAG;
     led_config.channel[i].black[0] = led_config.channel[i].black[1] =
         led_config.channel[i].black[2] = -1;
+    led_config.channel[i].protocol = OWNLED_WS281X;
+    led_config.channel[i].frequency = 0;
+    led_config.channel[i].scaled = 0;
   }
 
   config_coloring_defaults();
@@ -247,7 +250,7 @@ static void readConfig() {
     }
   }
 
-  for (int i = 0; i < 8; i++) {
+  for (int i = 0; i < led_get_max_lines(); i++) {
     char varname[32];
 
     uint8_t mode = led_config.channel[i].mode;
@@ -274,10 +277,21 @@ static void readConfig() {
     nvs_get_i16(my_handle, varname, &led_config.channel[i].black[1]);
     sprintf(varname, "leds%db2", i);
     nvs_get_i16(my_handle, varname, &led_config.channel[i].black[2]);
+    sprintf(varname, "leds%dproto", i);
+    nvs_get_u8(my_handle, varname, &led_config.channel[i].protocol);
+    sprintf(varname, "leds%dfreq", i);
+    nvs_get_u32(my_handle, varname, &led_config.channel[i].frequency);
+    sprintf(varname, "leds%done", i);
+    nvs_get_u8(my_handle, varname, &led_config.channel[i].one);
+    sprintf(varname, "leds%dzero", i);
+    nvs_get_u8(my_handle, varname, &led_config.channel[i].zero);
+    sprintf(varname, "leds%dscaled", i);
+    nvs_get_u8(my_handle, varname, &led_config.channel[i].scaled);
   }
 
   size = sizeof(led_coloring);
   nvs_get_blob(my_handle, "coloring", &led_coloring, &size);
+  led_update_coloring();
 
   nvs_get_u8(my_handle, "channels", &led_config.channels);
   nvs_get_u8(my_handle, "prefix_leds", &led_config.prefix_leds);
@@ -320,7 +334,7 @@ void config_write_all() {
 
   nvs_erase_key(my_handle, "leds"); // remove config from version 1.0
 
-  for (int i = 0; i < 8; i++) {
+  for (int i = 0; i < led_get_max_lines(); i++) {
     char varname[32];
 
     uint8_t mode = led_config.channel[i].mode;
@@ -345,6 +359,16 @@ void config_write_all() {
     nvs_set_i16(my_handle, varname, led_config.channel[i].black[1]);
     sprintf(varname, "leds%db2", i);
     nvs_set_i16(my_handle, varname, led_config.channel[i].black[2]);
+    sprintf(varname, "leds%dproto", i);
+    nvs_set_u8(my_handle, varname, led_config.channel[i].protocol);
+    sprintf(varname, "leds%dfreq", i);
+    nvs_set_u32(my_handle, varname, led_config.channel[i].frequency);
+    sprintf(varname, "leds%done", i);
+    nvs_set_u8(my_handle, varname, led_config.channel[i].one);
+    sprintf(varname, "leds%dzero", i);
+    nvs_set_u8(my_handle, varname, led_config.channel[i].zero);
+    sprintf(varname, "leds%dscaled", i);
+    nvs_set_u8(my_handle, varname, led_config.channel[i].scaled);
   }
 
   ESP_ERROR_CHECK(nvs_set_u8(my_handle, "channels", led_config.channels));
@@ -511,25 +535,49 @@ void config_set_led_line(int line, enum LED_MODE mode, int size_x, int size_y,
   led_config.channel[line].black[0] = -1;
   led_config.channel[line].black[1] = -1;
   led_config.channel[line].black[2] = -1;
-
-  if (0 == strncmp(options, "black=", 6)) {
-    int16_t *black = led_config.channel[line].black;
-    int res =
-        sscanf(options + 6, "%hd,%hd,%hd", &black[0], &black[1], &black[2]);
-    ESP_LOGI(TAG, "option res %d", res);
-
-    for (int i = 0; i < res; i++) {
-      if (black[i] < 0 || black[i] >= size_x * size_y) {
-        black[i] = black[res - 1];
-        res--;
-        i--;
+  led_config.channel[line].protocol = OWNLED_WS281X;
+  led_config.channel[line].frequency = 0;
+  led_config.channel[line].scaled = 0;
+
+  /* options are separated by spaces, e.g. "apa102 black=10,11" */
+  while (options != NULL && *options != 0) {
+    if (0 == strncmp(options, "apa102", 6) ||
+        0 == strncmp(options, "sk9822", 6)) {
+      led_config.channel[line].protocol = OWNLED_APA102;
+    } else if (0 == strncmp(options, "scaled", 6)) {
+      /* the video may be reduced to the size of the network channels */
+      led_config.channel[line].scaled = 1;
+    } else if (0 == strncmp(options, "timing=", 7)) {
+      /* frequency in Hz, high time of one and zero bits in percent */
+      unsigned f, one, zero;
+      if (sscanf(options + 7, "%u,%u,%u", &f, &one, &zero) == 3 && one < 256 &&
+          zero < 256) {
+        led_config.channel[line].frequency = f;
+        led_config.channel[line].one = one;
+        led_config.channel[line].zero = zero;
       }
-    }
-    qsort(black, res, sizeof(int16_t), compare_short);
-    for (int i = res; i < 3; i++)
-      black[i] = -1;
+    } else if (0 == strncmp(options, "black=", 6)) {
+      int16_t *black = led_config.channel[line].black;
+      int res =
+          sscanf(options + 6, "%hd,%hd,%hd", &black[0], &black[1], &black[2]);
+      ESP_LOGI(TAG, "option res %d", res);
+
+      for (int i = 0; i < res; i++) {
+        if (black[i] < 0 || black[i] >= size_x * size_y) {
+          black[i] = black[res - 1];
+          res--;
+          i--;
+        }
+      }
+      qsort(black, res, sizeof(int16_t), compare_short);
+      for (int i = res; i < 3; i++)
+        black[i] = -1;
 
-    ESP_LOGI(TAG, "options %d %d %d %d", res, black[0], black[1], black[2]);
+      ESP_LOGI(TAG, "options %d %d %d %d", res, black[0], black[1], black[2]);
+    }
+    options = strchr(options, ' ');
+    while (options != NULL && *options == ' ')
+      options++;
   }
 }
 
@@ -546,17 +594,20 @@ void config_get_led_line(int line, enum LED_MODE *mode, int *size_x,
   *orientation = led_config.channel[line].orientation;
   *mode = led_config.channel[line].mode;
 
-  if (led_config.channel[line].black[0] == -1)
-    options[0] = 0;
-  else if (led_config.channel[line].black[1] == -1)
-    sprintf(options, "black=%d", led_config.channel[line].black[0]);
-  else if (led_config.channel[line].black[2] == -1)
-    sprintf(options, "black=%d,%d", led_config.channel[line].black[0],
-            led_config.channel[line].black[1]);
-  else
-    sprintf(options, "black=%d,%d,%d", led_config.channel[line].black[0],
-            led_config.channel[line].black[1],
-            led_config.channel[line].black[2]);
+  char *o = options;
+  *o = 0;
+  if (led_config.channel[line].protocol == OWNLED_APA102)
+    o += sprintf(o, "apa102 ");
+  if (led_config.channel[line].frequency != 0)
+    o += sprintf(o, "timing=%u,%u,%u ", led_config.channel[line].frequency,
+                 led_config.channel[line].one, led_config.channel[line].zero);
+  if (led_config.channel[line].scaled)
+    o += sprintf(o, "scaled ");
+  for (int i = 0; i < 3 && led_config.channel[line].black[i] != -1; i++)
+    o += sprintf(o, "%s%d", i == 0 ? "black=" : ",",
+                 led_config.channel[line].black[i]);
+  if (o > options && o[-1] == ' ')
+    o[-1] = 0;
 }
 
 /**
@@ -571,6 +622,7 @@ void config_coloring_reload() {
 
   size_t size = sizeof(led_coloring);
   nvs_get_blob(my_handle, "coloring", &led_coloring, &size);
+  led_update_coloring();
 
   nvs_close(my_handle);
 }
@@ -578,7 +630,10 @@ void config_coloring_reload() {
 static struct LED_COLORING defaults_led_coloring = {1, 0, 1, 0, 1,
                                                     0, 1, 0, 1, 0};
 
-void config_coloring_defaults() { led_coloring = defaults_led_coloring; }
+void config_coloring_defaults() {
+  led_coloring = defaults_led_coloring;
+  led_update_coloring();
+}
 
 void config_coloring_write() {
   nvs_handle my_handle;
@@ -11,6 +11,7 @@
 
 #include "decoding.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "esp_log.h"
@@ -22,22 +23,20 @@
 #include "mjpeg.h"
 #include "picojpeg.h"
 
-// static const char *TAG = "#decoding";
+static const char *TAG = "#decoding";
 
 static TaskHandle_t taskHandle;
-static int counter;
 static struct MJPEG_FILE *file;
 
-static unsigned char pNeed_bytes_callback(unsigned char *pBuf,
-                                          unsigned char buf_size,
-                                          unsigned char *pBytes_actually_read,
-                                          void *pCallback_data) {
-  *pBytes_actually_read =
-      buf_size + counter > file->size ? file->size - counter : buf_size;
-  memcpy(pBuf, file->buffer + counter, *pBytes_actually_read);
-  counter += *pBytes_actually_read;
-  return 0;
-}
+/** format of the headers the decoder has been initialized with */
+static uint32_t format;
+/** size and sampling of the image with these headers */
+static pjpeg_image_info_t image;
+
+/** MCUs of the current frame shown by any channel, one bit each */
+static uint32_t *covered;
+static int covered_size; /* allocated words */
+static int covered_mcus; /* MCUs of the frame */
 
 /*
  *
@@ -96,9 +95,87 @@ static unsigned char pNeed_bytes_callback(unsigned char *pBuf,
  } pjpeg_image_info_t;
  */
 
-static void block(int no, pjpeg_image_info_t *block) {
-  int x = block->m_MCUWidth * (no % block->m_MCUSPerRow);
-  int y = block->m_MCUHeight * (no / block->m_MCUSPerRow);
+/**
+ * reductions of the image in the order of preference, with the pixels per
+ * side of a reduced 8x8 block
+ */
+static const struct {
+  unsigned char reduce;
+  int size;
+} reductions[] = {
+    {PJPG_REDUCE_8, 1},
+    {PJPG_REDUCE_4, 2},
+    {PJPG_REDUCE_2, 4},
+    {PJPG_REDUCE_NONE, 8},
+};
+
+/**
+ * strongest reduction of the image still covering all network channels. The
+ * image is reduced only if all these channels have the option "scaled", as
+ * their offsets then refer to the reduced image.
+ */
+static int reduction(const pjpeg_image_info_t *info) {
+  int w, h;
+  led_network_size(&w, &h);
+  int scaled = led_network_scaled();
+
+  int r = 0;
+  while (reductions[r].size < 8 &&
+         (!scaled || info->m_width * reductions[r].size < w * 8 ||
+          info->m_height * reductions[r].size < h * 8))
+    r++;
+  return r;
+}
+
+/**
+ * mark the MCUs overlapping the channels showing network data, n pixels per
+ * side of a block. Without memory, all MCUs are decoded.
+ */
+static void cover(const pjpeg_image_info_t *info, int n) {
+  int cols = info->m_MCUSPerRow;
+  int rows = info->m_MCUSPerCol;
+  int size = (cols * rows + 31) / 32;
+
+  covered_mcus = cols * rows;
+
+  if (size > covered_size) {
+    free(covered);
+    covered = malloc(size * sizeof(uint32_t));
+    covered_size = covered ? size : 0;
+    if (covered == NULL) {
+      ESP_LOGE(TAG, "no memory for %d MCUs", cols * rows);
+      return;
+    }
+  }
+  memset(covered, 0, size * sizeof(uint32_t));
+
+  int mw = info->m_MCUWidth / 8 * n;
+  int mh = info->m_MCUHeight / 8 * n;
+  for (int c = 0; c < led_get_max_lines(); c++) {
+    int x, y, w, h;
+    if (!led_network_area(c, &x, &y, &w, &h) || x + w <= 0 || y + h <= 0)
+      continue;
+
+    int x0 = x > 0 ? x / mw : 0;
+    int y0 = y > 0 ? y / mh : 0;
+    int x1 = (x + w - 1) / mw < cols ? (x + w - 1) / mw : cols - 1;
+    int y1 = (y + h - 1) / mh < rows ? (y + h - 1) / mh : rows - 1;
+    for (int my = y0; my <= y1; my++)
+      for (int mx = x0; mx <= x1; mx++) {
+        int no = mx + my * cols;
+        covered[no / 32] |= 1U << (no % 32);
+      }
+  }
+}
+
+static inline bool is_covered(int no) {
+  return !covered || no >= covered_mcus ||
+         covered[no / 32] & (1U << (no % 32));
+}
+
+static void block(int no, pjpeg_image_info_t *block, int n) {
+  int x = block->m_MCUWidth / 8 * n * (no % block->m_MCUSPerRow);
+  int y = block->m_MCUHeight / 8 * n * (no / block->m_MCUSPerRow);
 
   /*
           ESP_LOGD(TAG,
@@ -109,60 +186,91 @@ static void block(int no, pjpeg_image_info_t *block) {
   */
   switch (block->m_scanType) {
   case PJPG_GRAYSCALE:
-    led_block(x, y, block->m_pMCUBufR, block->m_pMCUBufR, block->m_pMCUBufR);
+    led_write_block(x, y, n, n, block->m_pMCUBufR, block->m_pMCUBufR,
+                    block->m_pMCUBufR, 8);
     break;
   case PJPG_YH1V1:
-    led_block(x, y, block->m_pMCUBufR, block->m_pMCUBufG, block->m_pMCUBufB);
+    led_write_block(x, y, n, n, block->m_pMCUBufR, block->m_pMCUBufG,
+                    block->m_pMCUBufB, 8);
     break;
   case PJPG_YH2V1:
-    led_block(x, y, block->m_pMCUBufR, block->m_pMCUBufG, block->m_pMCUBufB);
-    led_block(x + 8, y, block->m_pMCUBufR + 64, block->m_pMCUBufG + 64,
-              block->m_pMCUBufB + 64);
+    led_write_block(x, y, n, n, block->m_pMCUBufR, block->m_pMCUBufG,
+                    block->m_pMCUBufB, 8);
+    led_write_block(x + n, y, n, n, block->m_pMCUBufR + 64,
+                    block->m_pMCUBufG + 64, block->m_pMCUBufB + 64, 8);
     break;
   case PJPG_YH1V2:
-    led_block(x, y, block->m_pMCUBufR, block->m_pMCUBufG, block->m_pMCUBufB);
-    led_block(x, y + 8, block->m_pMCUBufR + 128, block->m_pMCUBufG + 128,
-              block->m_pMCUBufB + 128);
+    led_write_block(x, y, n, n, block->m_pMCUBufR, block->m_pMCUBufG,
+                    block->m_pMCUBufB, 8);
+    led_write_block(x, y + n, n, n, block->m_pMCUBufR + 128,
+                    block->m_pMCUBufG + 128, block->m_pMCUBufB + 128, 8);
     break;
   case PJPG_YH2V2:
-    led_block(x, y, block->m_pMCUBufR, block->m_pMCUBufG, block->m_pMCUBufB);
-    led_block(x + 8, y, block->m_pMCUBufR + 64, block->m_pMCUBufG + 64,
-              block->m_pMCUBufB + 64);
-    led_block(x, y + 8, block->m_pMCUBufR + 128, block->m_pMCUBufG + 128,
-              block->m_pMCUBufB + 128);
-    led_block(x + 8, y + 8, block->m_pMCUBufR + 192, block->m_pMCUBufG + 192,
-              block->m_pMCUBufB + 192);
+    led_write_block(x, y, n, n, block->m_pMCUBufR, block->m_pMCUBufG,
+                    block->m_pMCUBufB, 8);
+    led_write_block(x + n, y, n, n, block->m_pMCUBufR + 64,
+                    block->m_pMCUBufG + 64, block->m_pMCUBufB + 64, 8);
+    led_write_block(x, y + n, n, n, block->m_pMCUBufR + 128,
+                    block->m_pMCUBufG + 128, block->m_pMCUBufB + 128, 8);
+    led_write_block(x + n, y + n, n, n, block->m_pMCUBufR + 192,
+                    block->m_pMCUBufG + 192, block->m_pMCUBufB + 192, 8);
     break;
   }
 }
 
 static void decodeFile() {
-  file = mjpeg_frame_access(0);
+  file = mjpeg_frame_next();
   if (!file)
     return;
-  if (!file->decoded && file->size > 0) {
-    file->decoded = true;
-    counter = 0;
+  if (file->size > 0) {
+    int res;
+    if (file->format != format) {
+      // Initializes the decompressor with the new headers.
+      format = 0;
+      res = pjpeg_decode_init_memory(&image, file->buffer, file->size, 0);
+      ESP_ERROR_CHECK(res == 0 ? ESP_OK : ESP_FAIL);
+      format = file->format;
+    }
 
-    // Initializes the decompressor.
-    pjpeg_image_info_t pInfo;
-    int res = pjpeg_decode_init(&pInfo, pNeed_bytes_callback, (void *)file, 0);
+    // Keeps the tables of the decompressor, now knowing the image size.
+    int r = reduction(&image);
+    res = pjpeg_decode_rescan(&image, file->buffer + file->header,
+                              file->size - file->header, reductions[r].reduce);
     ESP_ERROR_CHECK(res == 0 ? ESP_OK : ESP_FAIL);
 
-    int i = 0;
-    for (;;) {
-      // Decompresses the file's next MCU. Returns 0 on success,
-      // PJPG_NO_MORE_BLOCKS if no more blocks are available, or an error code.
-      res = pjpeg_decode_mcu();
-      if (res == PJPG_NO_MORE_BLOCKS)
+    // MCUs not shown are entropy decoded only, for the DC prediction.
+    cover(&image, reductions[r].size);
+
+    // The LEDs of lost restart intervals keep the last image.
+    for (int c = 0; c < file->chunks; c++) {
+      const struct MJPEG_CHUNK *chunk = &file->chunk[c];
+      if (c > 0 &&
+          pjpeg_decode_restart(chunk->interval, file->buffer + chunk->offset,
+                               file->size - chunk->offset))
         break;
-      ESP_ERROR_CHECK(res == 0 ? ESP_OK : ESP_FAIL);
 
-      block(i, &pInfo);
-      i++;
+      int i = chunk->interval * file->restart;
+      int n = chunk->intervals * file->restart;
+      while (chunk->intervals < 0 || n-- > 0) {
+        // Decompresses the file's next MCU. Returns 0 on success,
+        // PJPG_NO_MORE_BLOCKS if no more blocks are available, or an error
+        // code.
+        bool shown = is_covered(i);
+        res = shown ? pjpeg_decode_mcu() : pjpeg_skip_mcu();
+        if (res == PJPG_NO_MORE_BLOCKS)
+          break;
+        if (res != 0 && file->partial) {
+          ESP_LOGW(TAG, "damaged restart interval %d", i / file->restart);
+          break;
+        }
+        ESP_ERROR_CHECK(res == 0 ? ESP_OK : ESP_FAIL);
+
+        if (shown)
+          block(i, &image, reductions[r].size);
+        i++;
+      }
     }
   }
-  mjpeg_frame_release();
 }
 
 static void task(void *args) {
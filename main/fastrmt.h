@@ -12,7 +12,24 @@
 #ifndef MAIN_FASTRMT_H_
 #define MAIN_FASTRMT_H_
 
+#include <stdint.h>
+
 #define FASTRMT_MAXIMAL_LINES (8)
-#define FASTRMT_MINIMAL_LEDS (616)
+
+/* upper limit of LEDs per line, the buffers are allocated at runtime */
+#define FASTRMT_MAXIMAL_LEDS (8192)
+
+/**
+ * statistics of the level 5 interrupt per core, filled by fastrmt.S
+ */
+struct FASTRMT_STATS {
+  uint32_t cycles;      /* CPU cycles spent in the interrupt, lower 32 bits */
+  uint32_t cycles_high; /* upper 32 bits */
+  uint32_t max;         /* cycles of the longest call */
+  uint32_t late;        /* refills after the RMT had sent both half blocks */
+  uint32_t calls;
+};
+
+extern struct FASTRMT_STATS fastrmt_stats[2];
 
 #endif /* MAIN_FASTRMT_H_ */
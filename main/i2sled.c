@@ -0,0 +1,331 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * i2sled.c
+ *
+ * single wire LED lines sent in parallel by the I2S unit
+ */
+
+#include "i2sled.h"
+
+#include "driver/gpio.h"
+#include "driver/periph_ctrl.h"
+#include "esp32/rom/gpio.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_intr_alloc.h"
+#include "esp_log.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/i2s_struct.h"
+#include "soc/lldesc.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "#i2sled";
+
+/**
+ * The I2S unit runs in 16 bit LCD mode and sends all lines in parallel. Each
+ * LED bit takes three samples: the first is high on all lines still sending,
+ * the second carries the data bit and the third is low. Thus, the duty cycles
+ * of the pulses are fixed to 1/3 and 2/3.
+ */
+
+/** PLL_D2 clock feeding the I2S unit */
+#define I2SLED_CLOCK (160e6)
+
+/** sample rate is I2SLED_CLOCK / (N + b/a) / (2 * I2SLED_BCK_DIV) */
+#define I2SLED_BCK_DIV (2)
+
+/** LED bytes per DMA buffer */
+#define I2SLED_CHUNK (32)
+
+#define I2SLED_BUFFER_SIZE (I2SLED_CHUNK * I2SLED_SAMPLES_PER_BYTE * 2)
+
+static intr_handle_t isr_handle;
+static uint8_t num_lines;
+static uint32_t frequency = 800000;
+static uint32_t line_frequency[I2SLED_MAXIMAL_LINES];
+
+static lldesc_t desc[2];
+static uint16_t *buffer[2];
+static bool latch[2];
+
+static uint8_t *input[I2SLED_MAXIMAL_LINES];
+static uint32_t length[I2SLED_MAXIMAL_LINES];
+static uint32_t position, total;
+static volatile bool finished = true;
+
+/**
+ * transpose a 8x8 bit matrix (Hacker's Delight, 7-3). Byte k of the result,
+ * counted from the most significant byte of hi followed by lo, holds bit 7-k
+ * of all lines with line l in bit l.
+ */
+static inline IRAM_ATTR void i2sled_transpose(const uint8_t *b, uint32_t *hi,
+                                              uint32_t *lo) {
+  uint32_t x = ((uint32_t)b[7] << 24) | ((uint32_t)b[6] << 16) |
+               ((uint32_t)b[5] << 8) | b[4];
+  uint32_t y = ((uint32_t)b[3] << 24) | ((uint32_t)b[2] << 16) |
+               ((uint32_t)b[1] << 8) | b[0];
+  uint32_t t;
+
+  t = (x ^ (x >> 7)) & 0x00AA00AA;
+  x = x ^ t ^ (t << 7);
+  t = (y ^ (y >> 7)) & 0x00AA00AA;
+  y = y ^ t ^ (t << 7);
+
+  t = (x ^ (x >> 14)) & 0x0000CCCC;
+  x = x ^ t ^ (t << 14);
+  t = (y ^ (y >> 14)) & 0x0000CCCC;
+  y = y ^ t ^ (t << 14);
+
+  *hi = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+  *lo = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+}
+
+IRAM_ATTR void i2sled_encode(uint16_t *dst, uint8_t *const *input,
+                             const uint32_t *length, uint8_t lines,
+                             uint32_t pos, uint32_t count) {
+  uint32_t hi[2] = {0, 0}, lo[2] = {0, 0}; /* lines 0-7 and 8-15 */
+  uint8_t b[I2SLED_MAXIMAL_LINES] = {0};     /* unused lines stay low */
+
+  for (; count > 0; count--, pos++, dst += I2SLED_SAMPLES_PER_BYTE) {
+    uint16_t active = 0;
+
+    for (uint8_t l = 0; l < lines; l++) {
+      if (pos < length[l]) {
+        b[l] = input[l][pos];
+        active |= 1 << l;
+      } else
+        b[l] = 0;
+    }
+
+    i2sled_transpose(b, &hi[0], &lo[0]);
+    if (lines > 8)
+      i2sled_transpose(b + 8, &hi[1], &lo[1]);
+
+    for (int k = 0; k < 8; k++) {
+      const uint32_t *word = k < 4 ? hi : lo;
+      uint32_t shift = 24 - 8 * (k & 3);
+      uint16_t bits = ((word[0] >> shift) & 0xff) | ((word[1] >> shift) << 8);
+      dst[I2SLED_SAMPLE(k * 3 + 0)] = active;
+      dst[I2SLED_SAMPLE(k * 3 + 1)] = bits;
+      dst[I2SLED_SAMPLE(k * 3 + 2)] = 0;
+    }
+  }
+}
+
+/**
+ * refill a DMA buffer, which has been sent. After the last byte, the lines
+ * stay low for a whole buffer to latch the LEDs.
+ */
+static IRAM_ATTR void i2sled_fill(int i) {
+  if (position < total) {
+    i2sled_encode(buffer[i], input, length, num_lines, position, I2SLED_CHUNK);
+    position += I2SLED_CHUNK;
+    latch[i] = false;
+  } else {
+    memset(buffer[i], 0, I2SLED_BUFFER_SIZE);
+    latch[i] = true;
+  }
+}
+
+static IRAM_ATTR void i2sled_isr(void *arg) {
+  if (I2S1.int_st.out_eof) {
+    int i = I2S1.out_eof_des_addr == (uint32_t)&desc[0] ? 0 : 1;
+    if (latch[i]) {
+      I2S1.conf.tx_start = 0;
+      I2S1.out_link.stop = 1;
+      I2S1.int_ena.out_eof = 0;
+      finished = true;
+    } else
+      i2sled_fill(i);
+  }
+  I2S1.int_clr.val = I2S1.int_st.val;
+}
+
+static void i2sled_apply_frequency() {
+  double div = I2SLED_CLOCK / (2. * I2SLED_BCK_DIV * I2SLED_SAMPLES_PER_BIT *
+                               frequency);
+  uint32_t n = div;
+  uint32_t b = round((div - n) * 63);
+  if (b == 63) {
+    n++;
+    b = 0;
+  }
+  I2S1.clkm_conf.clkm_div_a = 63;
+  I2S1.clkm_conf.clkm_div_b = b;
+  I2S1.clkm_conf.clkm_div_num = n;
+  ESP_LOGD(TAG, "frequency %d div %d+%d/63", frequency, n, b);
+}
+
+/**
+ * the duty cycles are given by the samples per bit, only the frequency is used.
+ * All lines share one clock, which runs at the rate of the slowest line.
+ */
+static void i2sled_set_pulses(uint8_t line, uint32_t f, uint8_t one,
+                              uint8_t zero) {
+  if (line >= I2SLED_MAXIMAL_LINES)
+    return;
+  line_frequency[line] = f;
+
+  frequency = f;
+  for (uint8_t i = 0; i < num_lines; i++)
+    if (line_frequency[i] != 0 && line_frequency[i] < frequency)
+      frequency = line_frequency[i];
+  if (isr_handle)
+    i2sled_apply_frequency();
+}
+
+static esp_err_t i2sled_init(const uint8_t *gpio, uint8_t lines) {
+  if (lines > I2SLED_MAXIMAL_LINES)
+    return ESP_ERR_INVALID_ARG;
+  num_lines = lines;
+
+  for (int i = 0; i < 2; i++) {
+    buffer[i] = heap_caps_calloc(I2SLED_BUFFER_SIZE, 1, MALLOC_CAP_DMA);
+    if (buffer[i] == NULL) {
+      ESP_LOGE(TAG, "no memory for DMA buffers");
+      return ESP_ERR_NO_MEM;
+    }
+    desc[i].size = desc[i].length = I2SLED_BUFFER_SIZE;
+    desc[i].buf = (uint8_t *)buffer[i];
+    desc[i].offset = 0;
+    desc[i].sosf = 0;
+    desc[i].eof = 1;
+    desc[i].owner = 1;
+    desc[i].qe.stqe_next = &desc[i ^ 1];
+  }
+
+  for (uint8_t i = 0; i < lines; i++) {
+    gpio_pad_select_gpio(gpio[i]);
+    gpio_set_level(gpio[i], 0);
+    gpio_set_direction(gpio[i], GPIO_MODE_OUTPUT);
+    gpio_matrix_out(gpio[i], I2S1O_DATA_OUT8_IDX + i, false, false);
+  }
+
+  periph_module_enable(PERIPH_I2S1_MODULE);
+
+  I2S1.conf.tx_reset = 1;
+  I2S1.conf.tx_reset = 0;
+  I2S1.conf.tx_fifo_reset = 1;
+  I2S1.conf.tx_fifo_reset = 0;
+  I2S1.lc_conf.out_rst = 1;
+  I2S1.lc_conf.out_rst = 0;
+
+  I2S1.conf2.val = 0;
+  I2S1.conf2.lcd_en = 1;
+
+  I2S1.sample_rate_conf.val = 0;
+  I2S1.sample_rate_conf.tx_bits_mod = 16;
+  I2S1.sample_rate_conf.tx_bck_div_num = I2SLED_BCK_DIV;
+
+  I2S1.clkm_conf.val = 0;
+  I2S1.clkm_conf.clka_en = 0;
+  I2S1.clkm_conf.clk_en = 1;
+  i2sled_apply_frequency();
+
+  I2S1.fifo_conf.val = 0;
+  I2S1.fifo_conf.tx_fifo_mod = 1;
+  I2S1.fifo_conf.tx_fifo_mod_force_en = 1;
+  I2S1.fifo_conf.tx_data_num = 32;
+  I2S1.fifo_conf.dscr_en = 1;
+
+  I2S1.conf_chan.val = 0;
+  I2S1.conf_chan.tx_chan_mod = 1;
+
+  I2S1.conf1.val = 0;
+  I2S1.conf1.tx_pcm_bypass = 1;
+  I2S1.conf1.tx_stop_en = 1;
+
+  I2S1.conf.tx_right_first = 1;
+  I2S1.conf.tx_msb_right = 1;
+  I2S1.timing.val = 0;
+
+  I2S1.int_ena.val = 0;
+  I2S1.int_clr.val = 0xffffffff;
+
+  return esp_intr_alloc(ETS_I2S1_INTR_SOURCE,
+                        ESP_INTR_FLAG_LEVEL3 | ESP_INTR_FLAG_IRAM, i2sled_isr,
+                        NULL, &isr_handle);
+}
+
+static void i2sled_stop() {
+  if (isr_handle == NULL)
+    return;
+  I2S1.int_ena.out_eof = 0;
+  I2S1.conf.tx_start = 0;
+  I2S1.out_link.stop = 1;
+  finished = true;
+}
+
+static void i2sled_send(uint8_t *const *in, const uint32_t *len) {
+  if (isr_handle == NULL)
+    return;
+  i2sled_stop();
+
+  total = 0;
+  for (uint8_t i = 0; i < num_lines; i++) {
+    input[i] = in[i];
+    length[i] = in[i] ? len[i] : 0;
+    if (length[i] > total)
+      total = length[i];
+  }
+  if (total == 0)
+    return;
+
+  finished = false;
+  position = 0;
+  i2sled_fill(0);
+  i2sled_fill(1);
+
+  I2S1.conf.tx_reset = 1;
+  I2S1.conf.tx_reset = 0;
+  I2S1.conf.tx_fifo_reset = 1;
+  I2S1.conf.tx_fifo_reset = 0;
+  I2S1.lc_conf.out_rst = 1;
+  I2S1.lc_conf.out_rst = 0;
+
+  I2S1.out_link.addr = (uint32_t)&desc[0];
+  I2S1.int_clr.val = 0xffffffff;
+  I2S1.int_ena.out_eof = 1;
+  I2S1.out_link.start = 1;
+  I2S1.conf.tx_start = 1;
+}
+
+static esp_err_t i2sled_isFinished() {
+  return finished ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+static void i2sled_free() {
+  if (isr_handle == NULL)
+    return;
+  i2sled_stop();
+  I2S1.int_ena.val = 0;
+  esp_intr_free(isr_handle);
+  isr_handle = NULL;
+  periph_module_disable(PERIPH_I2S1_MODULE);
+  for (int i = 0; i < 2; i++) {
+    heap_caps_free(buffer[i]);
+    buffer[i] = NULL;
+  }
+}
+
+static esp_err_t i2sled_attach(uint8_t line, uint8_t gpio) {
+  if (line >= num_lines)
+    return ESP_ERR_INVALID_ARG;
+  gpio_matrix_out(gpio, I2S1O_DATA_OUT8_IDX + line, false, false);
+  return ESP_OK;
+}
+
+const struct OWNLED_DRIVER i2sled_driver = {
+    .name = "i2s",
+    .init = i2sled_init,
+    .set_pulses = i2sled_set_pulses,
+    .send = i2sled_send,
+    .isFinished = i2sled_isFinished,
+    .stop = i2sled_stop,
+    .free = i2sled_free,
+    .attach = i2sled_attach,
+};
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * i2sled.h
+ *
+ * single wire LED lines sent in parallel by the I2S unit
+ */
+
+#ifndef MAIN_I2SLED_H_
+#define MAIN_I2SLED_H_
+
+#include "ownled.h"
+#include <stdint.h>
+
+#define I2SLED_MAXIMAL_LINES (16)
+
+/** samples per LED bit: high, data, low */
+#define I2SLED_SAMPLES_PER_BIT (3)
+
+/** 16 bit samples needed to send one byte on all lines */
+#define I2SLED_SAMPLES_PER_BYTE (8 * I2SLED_SAMPLES_PER_BIT)
+
+/**
+ * index of a sample in the DMA buffer. The I2S unit sends the upper half word
+ * of each 32 bit word first.
+ */
+#define I2SLED_SAMPLE(i) ((i) ^ 1)
+
+/** I2S unit in parallel mode with DMA, up to 16 lines */
+extern const struct OWNLED_DRIVER i2sled_driver;
+
+/**
+ * transpose the bytes pos..pos+count-1 of all lines into bit sliced samples.
+ * Bit k of a sample belongs to line k. Lines shorter than pos+count stay low.
+ */
+void i2sled_encode(uint16_t *dst, uint8_t *const *input,
+                   const uint32_t *length, uint8_t lines, uint32_t pos,
+                   uint32_t count);
+
+#endif /* MAIN_I2SLED_H_ */
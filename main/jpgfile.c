@@ -24,6 +24,69 @@ Appendix B
    RTP/JPEG body.
 */
 
+/*
+ * Table K.1 from JPEG spec.
+ */
+static const uint8_t jpeg_luma_quantizer[64] = {
+    16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+    14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+    18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+
+/*
+ * Table K.2 from JPEG spec.
+ */
+static const uint8_t jpeg_chroma_quantizer[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+/* the quantization tables of a DQT segment are in zigzag order */
+static const uint8_t zigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/*
+ * Call MakeTables with the Q factor and two u_char[64] return arrays
+ */
+void jpegtables(int q, uint8_t *lqt, uint8_t *cqt) {
+  int i;
+  int factor = q;
+
+  if (q < 1)
+    factor = 1;
+  if (q > 99)
+    factor = 99;
+  if (q < 50)
+    q = 5000 / factor;
+  else
+    q = 200 - factor * 2;
+
+  for (i = 0; i < 64; i++) {
+    int lq = (jpeg_luma_quantizer[zigzag[i]] * q + 50) / 100;
+    int cq = (jpeg_chroma_quantizer[zigzag[i]] * q + 50) / 100;
+
+    /* Limit the quantizers to 1 <= q <= 255 */
+    if (lq < 1)
+      lq = 1;
+    else if (lq > 255)
+      lq = 255;
+    lqt[i] = lq;
+
+    if (cq < 1)
+      cq = 1;
+    else if (cq > 255)
+      cq = 255;
+    cqt[i] = cq;
+  }
+}
+
 static uint8_t lum_dc_codelens[] = {
     0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
 };
@@ -82,7 +145,7 @@ static uint8_t chm_ac_symbols[] = {
     0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
 };
 
-static uint8_t *MakeQuantHeader(uint8_t *p, uint8_t *qt, int tableNo) {
+static uint8_t *MakeQuantHeader(uint8_t *p, const uint8_t *qt, int tableNo) {
   *p++ = 0xff;
   *p++ = 0xdb; /* DQT */
   *p++ = 0;    /* length msb */
@@ -92,6 +155,16 @@ static uint8_t *MakeQuantHeader(uint8_t *p, uint8_t *qt, int tableNo) {
   return (p + 64);
 }
 
+static uint8_t *MakeDRIHeader(uint8_t *p, uint16_t dri) {
+  *p++ = 0xff;
+  *p++ = 0xdd;       /* DRI */
+  *p++ = 0x0;        /* length msb */
+  *p++ = 4;          /* length lsb */
+  *p++ = dri >> 8;   /* dri msb */
+  *p++ = dri & 0xff; /* dri lsb */
+  return (p);
+}
+
 static uint8_t *MakeHuffmanHeader(uint8_t *p, uint8_t *codelens, int ncodes,
                                   uint8_t *symbols, int nsymbols, int tableNo,
                                   int tableClass) {
@@ -125,7 +198,8 @@ static uint8_t *MakeHuffmanHeader(uint8_t *p, uint8_t *codelens, int ncodes,
  *    interchange format (except for possible trailing garbage and
  *    absence of an EOI marker to terminate the scan).
  */
-int jpegfile(uint8_t *p, int type, int w, int h, uint8_t *qt) {
+static int MakeHeaders(uint8_t *p, int type, int w, int h, const uint8_t *lqt,
+                       const uint8_t *cqt, uint16_t dri) {
   uint8_t *start = p;
 
   /* convert from blocks to pixels */
@@ -135,8 +209,11 @@ int jpegfile(uint8_t *p, int type, int w, int h, uint8_t *qt) {
   *p++ = 0xff;
   *p++ = 0xd8; /* SOI */
 
-  p = MakeQuantHeader(p, qt, 0);
-  //        p = MakeQuantHeader(p, qt, 1);
+  p = MakeQuantHeader(p, lqt, 0);
+  p = MakeQuantHeader(p, cqt, 1);
+
+  if (dri != 0)
+    p = MakeDRIHeader(p, dri);
 
   *p++ = 0xff;
   *p++ = 0xc0;   /* SOF */
@@ -156,10 +233,10 @@ int jpegfile(uint8_t *p, int type, int w, int h, uint8_t *qt) {
   *p++ = 0;      /* quant table 0 */
   *p++ = 1;      /* comp 1 */
   *p++ = 0x11;   /* hsamp = 1, vsamp = 1 */
-  *p++ = 0;      /* quant table 1 */
+  *p++ = 1;      /* quant table 1 */
   *p++ = 2;      /* comp 2 */
   *p++ = 0x11;   /* hsamp = 1, vsamp = 1 */
-  *p++ = 0;      /* quant table 1 */
+  *p++ = 1;      /* quant table 1 */
   p = MakeHuffmanHeader(p, lum_dc_codelens, sizeof(lum_dc_codelens),
                         lum_dc_symbols, sizeof(lum_dc_symbols), 0, 0);
   p = MakeHuffmanHeader(p, lum_ac_codelens, sizeof(lum_ac_codelens),
@@ -186,3 +263,38 @@ int jpegfile(uint8_t *p, int type, int w, int h, uint8_t *qt) {
 
   return (p - start);
 };
+
+/*
+ * The headers generated last. They are copied again as long as the format of
+ * the stream stays the same.
+ */
+static struct {
+  uint32_t format; /* 0 if empty */
+  int type, w, h;
+  uint16_t dri;
+  uint8_t lqt[64], cqt[64];
+  int size;
+  uint8_t headers[JPEGFILE_MAX_SIZE];
+} last;
+
+int jpegfile(uint8_t *p, int type, int w, int h, const uint8_t *lqt,
+             const uint8_t *cqt, uint16_t dri) {
+  if (last.format == 0 || last.type != type || last.w != w || last.h != h ||
+      last.dri != dri || memcmp(last.lqt, lqt, 64) ||
+      memcmp(last.cqt, cqt, 64)) {
+    last.type = type;
+    last.w = w;
+    last.h = h;
+    last.dri = dri;
+    memcpy(last.lqt, lqt, 64);
+    memcpy(last.cqt, cqt, 64);
+    last.size = MakeHeaders(last.headers, type, w, h, lqt, cqt, dri);
+    if (++last.format == 0)
+      last.format = 1;
+  }
+
+  memcpy(p, last.headers, last.size);
+  return last.size;
+}
+
+uint32_t jpegfile_format() { return last.format; }
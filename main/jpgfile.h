@@ -14,6 +14,17 @@
 
 #include <stdint.h>
 
-int jpegfile(uint8_t *p, int type, int w, int h, uint8_t *qt);
+/** maximal length of the headers generated by jpegfile() */
+#define JPEGFILE_MAX_SIZE (612)
+
+int jpegfile(uint8_t *p, int type, int w, int h, const uint8_t *lqt,
+             const uint8_t *cqt, uint16_t dri);
+
+/**
+ * identifies the headers returned by the last call of jpegfile(). The value
+ * changes whenever the headers differ from the ones before.
+ */
+uint32_t jpegfile_format();
+void jpegtables(int q, uint8_t *lqt, uint8_t *cqt);
 
 #endif /* MAIN_JPGFILE_H_ */
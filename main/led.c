@@ -12,6 +12,7 @@
 
 #include <math.h>
 #include <netdb.h>
+#include <stdlib.h>
 #include <string.h>
 //#include "defs.h"
 
@@ -40,7 +41,8 @@ struct LED_COLORING led_coloring = {1, 0, 1, 0, 1, 0, 1, 0, 1, 0};
 static float diagonale(float x, float y) { return sqrtf(x * x + y * y); }
 
 /**
- * return the number of led lines support by this hardware
+ * return the number of led lines that can be configured. The output driver
+ * may have less, see ownled_getChannels().
  */
 int led_get_max_lines() { return LED_MAX_LINES; }
 
@@ -137,6 +139,11 @@ static void hsv(float *r, float *g, float *b) {
   }
 }
 
+/* the white die has the global contrast and brightness only */
+static float contrast_white(float w) {
+  return w * led_coloring.contrast + led_coloring.brightness;
+}
+
 static void contrasts(float *r, float *g, float *b) {
   *r = *r * led_coloring.contrast * led_coloring.red_contrast +
        led_coloring.brightness + led_coloring.red_brightness;
@@ -146,24 +153,241 @@ static void contrasts(float *r, float *g, float *b) {
        led_coloring.brightness + led_coloring.blue_brightness;
 }
 
-void led_set_color(uint8_t c, uint16_t p, uint8_t r, uint8_t g, uint8_t b) {
+/**
+ * color pipeline. The transformation given by led_coloring is compiled into
+ * lookup tables whenever the coloring changes, so that led_set_color does not
+ * need any floating point operations.
+ */
+enum COLOR_KERNEL {
+  COLOR_IDENTITY, /* default coloring, pass through */
+  COLOR_LUT1D,    /* per channel contrast and brightness */
+  COLOR_LUT3D     /* hue and saturation followed by COLOR_LUT1D */
+};
+
+#define LUT3D_NODES (17)
+#define LUT3D_SIZE (LUT3D_NODES * LUT3D_NODES * LUT3D_NODES)
+
+struct COLOR_PIPELINE {
+  enum COLOR_KERNEL kernel;
+  uint8_t lut[4][256]; /* red, green, blue and white */
+  uint8_t (*lut3d)[3];
+  /* clocked LEDs are dimmed by their 5 bit global brightness, so that lut
+   * values are scaled up by 31 / global to keep their resolution */
+  uint8_t global;
+  uint8_t lut_clocked[3][256];
+  /* number of writers using the pipeline right now */
+  int users;
+};
+
+static struct COLOR_PIPELINE pipelines[2];
+static struct COLOR_PIPELINE *pipeline = &pipelines[0];
+
+/**
+ * take the current pipeline for a while. A pipeline replaced in the meantime
+ * is not rebuilt before all its users have released it.
+ */
+static struct COLOR_PIPELINE *led_pipeline_acquire() {
+  for (;;) {
+    struct COLOR_PIPELINE *cp = __atomic_load_n(&pipeline, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&cp->users, 1, __ATOMIC_SEQ_CST);
+    if (cp == __atomic_load_n(&pipeline, __ATOMIC_SEQ_CST))
+      return cp;
+    __atomic_sub_fetch(&cp->users, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+static void led_pipeline_release(struct COLOR_PIPELINE *cp) {
+  __atomic_sub_fetch(&cp->users, 1, __ATOMIC_SEQ_CST);
+}
+
+static uint8_t lut3d_index[256];
+static uint16_t lut3d_frac[256];
 
-  float fr = BYTEtoFLOAT(r);
-  float fg = BYTEtoFLOAT(g);
-  float fb = BYTEtoFLOAT(b);
+static inline int lerp(int a, int b, int f) {
+  return a + (((b - a) * f + 128) >> 8);
+}
+
+static void lut3d_apply(uint8_t (*lut)[3], uint8_t *r, uint8_t *g,
+                        uint8_t *b) {
+  const int dr = LUT3D_NODES * LUT3D_NODES;
+  const int dg = LUT3D_NODES;
+  int fr = lut3d_frac[*r];
+  int fg = lut3d_frac[*g];
+  int fb = lut3d_frac[*b];
+  uint8_t(*n)[3] =
+      lut + (lut3d_index[*r] * LUT3D_NODES + lut3d_index[*g]) * LUT3D_NODES +
+      lut3d_index[*b];
+  uint8_t res[3];
+
+  for (int c = 0; c < 3; c++) {
+    int c00 = lerp(n[0][c], n[dr][c], fr);
+    int c01 = lerp(n[1][c], n[dr + 1][c], fr);
+    int c10 = lerp(n[dg][c], n[dr + dg][c], fr);
+    int c11 = lerp(n[dg + 1][c], n[dr + dg + 1][c], fr);
+    res[c] = lerp(lerp(c00, c10, fg), lerp(c01, c11, fg), fb);
+  }
+  *r = res[0];
+  *g = res[1];
+  *b = res[2];
+}
+
+/**
+ * rebuild the color pipeline after led_coloring has been changed
+ */
+void led_update_coloring() {
+  struct COLOR_PIPELINE *cp =
+      pipeline == &pipelines[0] ? &pipelines[1] : &pipelines[0];
+
+  /* the previous pipeline may still be used, e.g. by the frame of the led
+   * task that has started before the last update */
+  while (__atomic_load_n(&cp->users, __ATOMIC_SEQ_CST) > 0)
+    vTaskDelay(1);
+
+  if (led_coloring.hue != 0.f || led_coloring.saturation != 1.f) {
+    if (cp->lut3d == NULL)
+      cp->lut3d = malloc(LUT3D_SIZE * sizeof(*cp->lut3d));
+    if (cp->lut3d == NULL) {
+      ESP_LOGE(TAG, "no memory for color lookup table");
+      cp->kernel = COLOR_LUT1D;
+    } else {
+      /* the interpolation grid is always the same, it is set up once */
+      if (lut3d_frac[255] == 0)
+        for (int i = 0; i < 256; i++) {
+          int n = i * (LUT3D_NODES - 1) / 255;
+          if (n == LUT3D_NODES - 1)
+            n--;
+          lut3d_index[i] = n;
+          lut3d_frac[i] = i * (LUT3D_NODES - 1) * 256 / 255 - n * 256;
+        }
 
-  hsv(&fr, &fg, &fb);
-  contrasts(&fr, &fg, &fb);
+      uint8_t(*node)[3] = cp->lut3d;
+      for (int r = 0; r < LUT3D_NODES; r++)
+        for (int g = 0; g < LUT3D_NODES; g++)
+          for (int b = 0; b < LUT3D_NODES; b++) {
+            float fr = r / (LUT3D_NODES - 1.f);
+            float fg = g / (LUT3D_NODES - 1.f);
+            float fb = b / (LUT3D_NODES - 1.f);
+            hsv(&fr, &fg, &fb);
+            (*node)[0] = lroundf(255.f * f0to1(fr));
+            (*node)[1] = lroundf(255.f * f0to1(fg));
+            (*node)[2] = lroundf(255.f * f0to1(fb));
+            node++;
+          }
+      cp->kernel = COLOR_LUT3D;
+    }
+  } else
+    cp->kernel = COLOR_LUT1D;
+
+  bool identity = true;
+  for (int i = 0; i < 256; i++) {
+    float fr = BYTEtoFLOAT(i);
+    float fg = fr;
+    float fb = fr;
+    contrasts(&fr, &fg, &fb);
+    cp->lut[0][i] = FLOATtoBYTE(fr);
+    cp->lut[1][i] = FLOATtoBYTE(fg);
+    cp->lut[2][i] = FLOATtoBYTE(fb);
+    cp->lut[3][i] = FLOATtoBYTE(contrast_white(BYTEtoFLOAT(i)));
+    if (cp->lut[0][i] != i || cp->lut[1][i] != i || cp->lut[2][i] != i ||
+        cp->lut[3][i] != i)
+      identity = false;
+  }
+  if (identity && cp->kernel == COLOR_LUT1D)
+    cp->kernel = COLOR_IDENTITY;
+
+  int maximum = 1;
+  for (int c = 0; c < 3; c++)
+    for (int i = 0; i < 256; i++)
+      if (cp->lut[c][i] > maximum)
+        maximum = cp->lut[c][i];
+  cp->global = (maximum * 31 + 254) / 255;
+  float scale = 31.f / cp->global;
+  for (int i = 0; i < 256; i++) {
+    float fr = BYTEtoFLOAT(i);
+    float fg = fr;
+    float fb = fr;
+    contrasts(&fr, &fg, &fb);
+    cp->lut_clocked[0][i] = FLOATtoBYTE(fr * scale);
+    cp->lut_clocked[1][i] = FLOATtoBYTE(fg * scale);
+    cp->lut_clocked[2][i] = FLOATtoBYTE(fb * scale);
+  }
 
-  r = FLOATtoBYTE(fr);
-  g = FLOATtoBYTE(fg);
-  b = FLOATtoBYTE(fb);
+  ESP_LOGD(TAG, "color pipeline kernel %d global %d", cp->kernel,
+           cp->global);
+  __atomic_store_n(&pipeline, cp, __ATOMIC_SEQ_CST);
+  ownled_setGlobalBrightness(cp->global);
+}
+
+/**
+ * send a color through the pipeline and store red, green, blue and white of
+ * the LED in rgbw. LEDs with a white die show the common part of the three
+ * colors with it, unless the source has its own white channel (w >= 0), which
+ * gets the contrast and brightness of white. Other LEDs show such a white with
+ * their three colors.
+ */
+static inline void led_pipeline(const struct COLOR_PIPELINE *cp, uint8_t c,
+                                uint16_t p, uint8_t r, uint8_t g, uint8_t b,
+                                int w, uint8_t *rgbw) {
+  bool white = ownled_lineHasWhite(c);
+  if (!white && w >= 0) {
+    r = r + w > 255 ? 255 : r + w;
+    g = g + w > 255 ? 255 : g + w;
+    b = b + w > 255 ? 255 : b + w;
+    w = -1;
+  }
+
+  switch (cp->kernel) {
+  case COLOR_LUT3D:
+    lut3d_apply(cp->lut3d, &r, &g, &b);
+    /* fall through */
+  case COLOR_LUT1D: {
+    const uint8_t(*lut)[256] =
+        led_config.channel[c].protocol == OWNLED_APA102 ? cp->lut_clocked
+                                                        : cp->lut;
+    r = lut[0][r];
+    g = lut[1][g];
+    b = lut[2][b];
+    if (w >= 0)
+      w = cp->lut[3][w];
+    break;
+  }
+  case COLOR_IDENTITY:
+    break;
+  }
 
   if (p == led_config.channel[c].black[0] ||
       p == led_config.channel[c].black[1] ||
-      p == led_config.channel[c].black[2])
+      p == led_config.channel[c].black[2]) {
     r = b = g = 0;
-  ownled_setPixel(c, p + led_config.prefix_leds, g, b, r);
+    if (w > 0)
+      w = 0;
+  }
+
+  if (white && w < 0) {
+    w = r < g ? r : g;
+    if (b < w)
+      w = b;
+    r -= w;
+    g -= w;
+    b -= w;
+  }
+  rgbw[0] = r;
+  rgbw[1] = g;
+  rgbw[2] = b;
+  rgbw[3] = w < 0 ? 0 : w;
+}
+
+static inline void led_set_rgbw(uint8_t c, uint16_t p, uint8_t r, uint8_t g,
+                                uint8_t b, int w) {
+  uint8_t rgbw[4];
+  struct COLOR_PIPELINE *cp = led_pipeline_acquire();
+  led_pipeline(cp, c, p, r, g, b, w, rgbw);
+  led_pipeline_release(cp);
+  ownled_setPixels(c, NULL, p + led_config.prefix_leds, 1, rgbw, 0);
+}
+
+void led_set_color(uint8_t c, uint16_t p, uint8_t r, uint8_t g, uint8_t b) {
+  led_set_rgbw(c, p, r, g, b, -1);
 }
 
 static inline void swap(int *a, int *b) {
@@ -174,19 +398,13 @@ static inline void swap(int *a, int *b) {
 
 static inline void invert(int *a, int sa) { *a = sa - *a - 1; }
 
-static void led_channel_rgb(int c, int x, int y, uint8_t r, uint8_t g,
-                            uint8_t b) {
-  struct LED_CONFIG_CHANNEL *lc = &led_config.channel[c];
-
-  x -= lc->ox;
-  y -= lc->oy;
+/**
+ * map a pixel coordinate of a channel to the position of the LED on the strip
+ */
+static int led_channel_index(struct LED_CONFIG_CHANNEL *lc, int x, int y) {
   int sx = lc->sx;
   int sy = lc->sy;
 
-  // pixel out of range
-  if (x < 0 || y < 0 || x >= sx || y >= sy)
-    return;
-
   switch (lc->orientation) {
   case LED_ORI0F_ZIGZAG:
   case LED_ORI0F_MEANDER:
@@ -246,47 +464,252 @@ static void led_channel_rgb(int c, int x, int y, uint8_t r, uint8_t g,
     break;
   }
 
-  led_set_color(c, x + y * sx, r, g, b);
+  return x + y * sx;
 }
 
-void led_rgb_rtp(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
-  for (int c = 0; c < led_get_max_lines(); c++) {
-    if (led_config.channel[c].mode == LED_MODE_NETWORK) {
-      led_channel_rgb(c, x, y, r, g, b);
+/**
+ * per channel lookup table from pixel coordinate (x + y * sx) to LED position.
+ * The network tasks read it, while the led task rebuilds it if the
+ * configuration changes. Thus, each channel has two maps: the new one is built
+ * besides the current one and replaces it, like the color pipelines.
+ */
+struct LED_MAP {
+  int16_t sx;
+  int16_t sy;
+  uint16_t *index;
+  /* number of readers using the map right now */
+  int users;
+};
+
+static struct LED_MAP led_maps[LED_MAXIMAL_LINES][2];
+static int led_map_current[LED_MAXIMAL_LINES];
+
+/**
+ * take the current map of a channel for a while. A map replaced in the
+ * meantime is not freed before all its users have released it.
+ */
+static struct LED_MAP *led_map_acquire(int c) {
+  for (;;) {
+    int current = __atomic_load_n(&led_map_current[c], __ATOMIC_SEQ_CST);
+    struct LED_MAP *m = &led_maps[c][current];
+    __atomic_add_fetch(&m->users, 1, __ATOMIC_SEQ_CST);
+    if (current == __atomic_load_n(&led_map_current[c], __ATOMIC_SEQ_CST))
+      return m;
+    __atomic_sub_fetch(&m->users, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+static void led_map_release(struct LED_MAP *m) {
+  __atomic_sub_fetch(&m->users, 1, __ATOMIC_SEQ_CST);
+}
+
+static void led_map_update(int c) {
+  struct LED_CONFIG_CHANNEL *lc = &led_config.channel[c];
+  int size = lc->sx > 0 && lc->sy > 0 ? lc->sx * lc->sy : 0;
+  int next = !led_map_current[c];
+  struct LED_MAP *m = &led_maps[c][next];
+
+  /* the unused map has no table, it has been freed after the last update */
+  m->sx = m->sy = 0;
+  if (size > 0) {
+    m->index = malloc(size * sizeof(uint16_t));
+    if (m->index == NULL) {
+      ESP_LOGE(TAG, "no memory for led map %d", c);
+      size = 0;
     }
   }
+
+  for (int y = 0; y < lc->sy && size; y++)
+    for (int x = 0; x < lc->sx; x++)
+      m->index[x + y * lc->sx] = led_channel_index(lc, x, y);
+  m->sy = size ? lc->sy : 0;
+  m->sx = size ? lc->sx : 0;
+  __atomic_store_n(&led_map_current[c], next, __ATOMIC_SEQ_CST);
+
+  /* the previous map may still be used, e.g. by a network span */
+  struct LED_MAP *old = &led_maps[c][!next];
+  while (__atomic_load_n(&old->users, __ATOMIC_SEQ_CST) > 0)
+    vTaskDelay(1);
+  free(old->index);
+  old->index = NULL;
+  old->sx = old->sy = 0;
 }
 
-void led_channel_block(int c, int x, int y, uint8_t *r, uint8_t *g,
-                       uint8_t *b) {
-  for (int iy = 0; iy < 8; iy++)
-    for (int ix = 0; ix < 8; ix++)
-      led_channel_rgb(c, x + ix, y + iy, *r++, *g++, *b++);
+static void led_channel_rgb(int c, int x, int y, uint8_t r, uint8_t g,
+                            uint8_t b) {
+  struct LED_CONFIG_CHANNEL *lc = &led_config.channel[c];
+  struct LED_MAP *m = led_map_acquire(c);
+
+  x -= lc->ox;
+  y -= lc->oy;
+
+  // pixel out of range
+  if (x >= 0 && y >= 0 && x < m->sx && y < m->sy)
+    led_set_color(c, m->index[x + y * m->sx], r, g, b);
+  led_map_release(m);
 }
 
-void led_block(int x, int y, uint8_t *r, uint8_t *g, uint8_t *b) {
+/** pixels of a span passing the color pipeline together */
+#define LED_SPAN_CHUNK (64)
+
+/**
+ * write a rectangle of pixels into all channels showing network data. Within
+ * a row, pixels are step bytes apart, rows are stride bytes apart.
+ */
+static void led_write_span(int x, int y, int w, int h, const uint8_t *r,
+                           const uint8_t *g, const uint8_t *b,
+                           const uint8_t *white, int step, int stride) {
+  struct COLOR_PIPELINE *cp = led_pipeline_acquire();
+
   for (int c = 0; c < led_get_max_lines(); c++) {
-    if (led_config.channel[c].mode == LED_MODE_NETWORK) {
-      led_channel_block(c, x, y, r, g, b);
+    if (led_config.channel[c].mode != LED_MODE_NETWORK)
+      continue;
+
+    struct LED_MAP *m = led_map_acquire(c);
+    int sx = m->sx;
+    int sy = m->sy;
+    int x0 = x - led_config.channel[c].ox;
+    int y0 = y - led_config.channel[c].oy;
+
+    // clip the span to the channel
+    int ix0 = x0 < 0 ? -x0 : 0;
+    int ix1 = x0 + w > sx ? sx - x0 : w;
+    int iy0 = y0 < 0 ? -y0 : 0;
+    int iy1 = y0 + h > sy ? sy - y0 : h;
+
+    for (int iy = iy0; iy < iy1; iy++) {
+      const uint16_t *index = m->index + (y0 + iy) * sx + x0;
+      int o = iy * stride + ix0 * step;
+      for (int ix = ix0; ix < ix1;) {
+        /* colors pass the pipeline in chunks, then go to the line at once */
+        uint8_t rgbw[LED_SPAN_CHUNK][4];
+        int n = ix1 - ix < LED_SPAN_CHUNK ? ix1 - ix : LED_SPAN_CHUNK;
+        for (int i = 0; i < n; i++, o += step)
+          led_pipeline(cp, c, index[ix + i], r[o], g[o], b[o],
+                       white ? white[o] : -1, rgbw[i]);
+        ownled_setPixels(c, index + ix, led_config.prefix_leds, n, rgbw[0],
+                         4);
+        ix += n;
+      }
     }
+    led_map_release(m);
+  }
+  led_pipeline_release(cp);
+}
+
+void led_write_row(int x, int y, int n, const uint8_t *r, const uint8_t *g,
+                   const uint8_t *b, int step) {
+  led_write_span(x, y, n, 1, r, g, b, NULL, step, 0);
+}
+
+void led_write_row_rgbw(int x, int y, int n, const uint8_t *r,
+                        const uint8_t *g, const uint8_t *b, const uint8_t *w,
+                        int step) {
+  led_write_span(x, y, n, 1, r, g, b, w, step, 0);
+}
+
+void led_write_block(int x, int y, int w, int h, const uint8_t *r,
+                     const uint8_t *g, const uint8_t *b, int stride) {
+  led_write_span(x, y, w, h, r, g, b, NULL, 1, stride);
+}
+
+int led_network_area(int c, int *x, int *y, int *w, int *h) {
+  if (led_config.channel[c].mode != LED_MODE_NETWORK)
+    return 0;
+
+  struct LED_MAP *m = led_map_acquire(c);
+  *x = led_config.channel[c].ox;
+  *y = led_config.channel[c].oy;
+  *w = m->sx;
+  *h = m->sy;
+  led_map_release(m);
+  return *w > 0;
+}
+
+void led_network_size(int *w, int *h) {
+  *w = *h = 0;
+  for (int c = 0; c < led_get_max_lines(); c++) {
+    int x, y, sx, sy;
+    if (!led_network_area(c, &x, &y, &sx, &sy))
+      continue;
+
+    if (x + sx > *w)
+      *w = x + sx;
+    if (y + sy > *h)
+      *h = y + sy;
   }
 }
 
+int led_network_scaled() {
+  int scaled = 0;
+  for (int c = 0; c < led_get_max_lines(); c++) {
+    int x, y, sx, sy;
+    if (!led_network_area(c, &x, &y, &sx, &sy))
+      continue;
+
+    if (!led_config.channel[c].scaled)
+      return 0;
+    scaled = 1;
+  }
+  return scaled;
+}
+
 static void handleNewConfig() {
+  /* lines switched off are darkened once, as they are not sent anymore */
+  bool blank = false;
   for (int i = 0; i < led_get_max_lines(); i++) {
+    if (led_config.channel[i].mode != LED_MODE_OFF || ownled_getSize(i) == 0)
+      continue;
+    for (uint16_t p = 0; p < ownled_getSize(i); p++)
+      ownled_setPixel(i, p, 0, 0, 0);
+    blank = true;
+  }
+  if (blank) {
+    ownled_send();
+    while (ownled_isFinished() != ESP_OK)
+      vTaskDelay(1);
+    vTaskDelay(1); /* the last bits and the latch */
+  }
+
+  for (int i = 0; i < led_get_max_lines(); i++) {
+    led_map_update(i);
     WS2812FX_init(i, led_config.channel[i].sx * led_config.channel[i].sy);
-    ownled_setSize(i, led_config.channel[i].sx * led_config.channel[i].sy +
-                          led_config.prefix_leds);
+
+    /* lines beyond the ones of the output driver are only stored */
+    if (i >= ownled_getChannels())
+      continue;
+    if (ownled_setProtocol(i, led_config.channel[i].protocol) != ESP_OK)
+      led_config.channel[i].protocol = OWNLED_WS281X;
+    if (ownled_set_line_pulses(i, led_config.channel[i].frequency,
+                               led_config.channel[i].one,
+                               led_config.channel[i].zero) != ESP_OK) {
+      ESP_LOGW(TAG, "line %d: invalid timing, using the global one", i);
+      led_config.channel[i].frequency = 0;
+      ownled_set_line_pulses(i, 0, 0, 0);
+    }
+    if (led_config.channel[i].mode == LED_MODE_OFF)
+      ownled_setSize(i, 0);
+    else
+      ownled_setSize(i, led_config.channel[i].sx * led_config.channel[i].sy +
+                            led_config.prefix_leds);
   }
+  ownled_updateLayout();
   framerate = led_config.refresh_rate;
 }
 
 static void fill(int line, uint8_t r, uint8_t g, uint8_t b) {
-  int size = led_config.channel[line].sx * led_config.channel[line].sy;
-  while (size > 0) {
-    size--;
-    led_set_color(line, size, r, g, b);
-  }
+  struct LED_CONFIG_CHANNEL *lc = &led_config.channel[line];
+  int size = lc->sx * lc->sy;
+  uint8_t rgbw[4];
+
+  /* one color for the whole line, then the black pixels on top */
+  struct COLOR_PIPELINE *cp = led_pipeline_acquire();
+  led_pipeline(cp, line, UINT16_MAX, r, g, b, -1, rgbw);
+  led_pipeline_release(cp);
+  ownled_setPixels(line, NULL, led_config.prefix_leds, size, rgbw, 0);
+  for (int i = 0; i < 3; i++)
+    if (lc->black[i] >= 0 && lc->black[i] < size)
+      led_set_color(line, lc->black[i], r, g, b);
 }
 
 static void fillFadeX(int line) {
@@ -767,7 +1190,7 @@ static void task(void *args) {
 void led_on() {
 
   led_counter = 0;
-  ownled_init();
+  ownled_init(ownled_default_driver());
   q = xQueueCreate(1, sizeof(struct LED_CONFIG));
   ESP_ERROR_CHECK(q != NULL ? ESP_OK : ESP_FAIL);
   ESP_ERROR_CHECK(xTaskCreate(task, "led_task", 4096, NULL, 2 /*high prio*/,
@@ -821,7 +1244,7 @@ void led_cube(float x, float y, float z) {
     break;
   }
 
-  uint16_t line = floorf(f0to1(z) * led_get_max_lines());
+  uint16_t line = floorf(f0to1(z) * ownled_getChannels());
   uint8_t pos =
       floorf(f0to1(x) * led_config.channel[0].sx) +
       floorf(f0to1(y) * led_config.channel[0].sy) * led_config.channel[0].sx +
@@ -850,7 +1273,7 @@ void led_cube2(int d, float x, float y, float z) {
   if (d < 0 || d > 31)
     return;
 
-  history_line[d] = floorf(f0to1(z) * led_get_max_lines());
+  history_line[d] = floorf(f0to1(z) * ownled_getChannels());
   history_pos[d] =
       floorf(f0to1(x) * led_config.channel[0].sx) +
       floorf(f0to1(y) * led_config.channel[0].sy) * led_config.channel[0].sx +
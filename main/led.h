@@ -14,6 +14,9 @@
 
 #include <stdint.h>
 
+/** lines that can be configured, independent of the output backend */
+#define LED_MAXIMAL_LINES (16)
+
 enum LED_ORIENTATION {
   LED_ORI0_ZIGZAG,
   LED_ORI0F_ZIGZAG,
@@ -135,13 +138,18 @@ struct LED_CONFIG_CHANNEL {
   int16_t ox;
   int16_t oy;
   int16_t black[3];
+  uint8_t protocol; /* enum OWNLED_PROTOCOL */
+  uint32_t frequency; /* own timing of the line, zero for the global one */
+  uint8_t one;
+  uint8_t zero;
+  uint8_t scaled; /* network data may be decoded at a reduced size */
 };
 
 struct LED_CONFIG {
   int16_t refresh_rate;
   uint8_t channels;
   uint8_t prefix_leds;
-  struct LED_CONFIG_CHANNEL channel[8];
+  struct LED_CONFIG_CHANNEL channel[LED_MAXIMAL_LINES];
   uint16_t artnet_width;
   uint16_t artnet_universe_offset;
 };
@@ -156,9 +164,31 @@ void led_set_framerate(float);
 
 void led_cube(float x, float y, float z);
 void led_cube2(int d, float x, float y, float z);
-void led_block(int x, int y, uint8_t *r, uint8_t *g, uint8_t *b);
+void led_update_coloring();
 void led_set_color(uint8_t c, uint16_t p, uint8_t r, uint8_t g, uint8_t b);
-void led_rgb_rtp(int x, int y, uint8_t r, uint8_t g, uint8_t b);
+void led_write_row(int x, int y, int n, const uint8_t *r, const uint8_t *g,
+                   const uint8_t *b, int step);
+void led_write_row_rgbw(int x, int y, int n, const uint8_t *r,
+                        const uint8_t *g, const uint8_t *b, const uint8_t *w,
+                        int step);
+void led_write_block(int x, int y, int w, int h, const uint8_t *r,
+                     const uint8_t *g, const uint8_t *b, int stride);
+/**
+ * area of the network data shown by channel c. Returns zero if the channel
+ * does not show network data.
+ */
+int led_network_area(int c, int *x, int *y, int *w, int *h);
+/**
+ * width and height of the area from the origin to the far edges of all
+ * channels showing network data, zero if there are none
+ */
+void led_network_size(int *w, int *h);
+/**
+ * nonzero if there are channels showing network data and all of them accept
+ * a video decoded at a reduced size. Their offsets then refer to the reduced
+ * video.
+ */
+int led_network_scaled();
 void led_trigger();
 
 #endif /* MAIN_LED_H_ */
@@ -12,12 +12,15 @@
 #include "mjpeg.h"
 
 #include <arpa/inet.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "decoding.h"
 #include "esp_log.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "jpgfile.h"
+#include "sdkconfig.h"
 #include "status.h"
 
 static const char *TAG = "#mjpeg";
@@ -49,6 +52,23 @@ struct __attribute__((packed)) rtp_mjpeg {
   uint8_t height;
 };
 
+/*
+ 0                   1                   2                   3
+ 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ |       Restart Interval        |F|L|       Restart Count       |
+ +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ */
+struct __attribute__((packed)) restartMarker {
+  uint16_t interval;
+  uint16_t flc;
+};
+
+#define RESTART_FIRST (0x8000)
+#define RESTART_LAST (0x4000)
+#define RESTART_COUNT (0x3fff)
+
 struct __attribute__((packed)) quantizationTable {
   uint8_t tbd;
   uint8_t precision;
@@ -56,48 +76,246 @@ struct __attribute__((packed)) quantizationTable {
   uint8_t data[0];
 };
 
-static struct MJPEG_FILE current;
-static struct MJPEG_FILE last;
-static xSemaphoreHandle xSemaphore;
+#define FRAMES CONFIG_CONTROLLER_MJPEG_FRAMES
+
+/*
+ * Ring of frames between the receiver (producer) and the decoder (consumer).
+ * head and tail count frames and are written by one side only. The producer
+ * assembles the frame in slot head, frames head-1 down to tail are complete.
+ * The decoder keeps its frame (held) at tail until it takes the next one, so
+ * that the web server can show it. The mutex only serializes the decoder and
+ * the web server, the receiver never waits.
+ */
+static struct {
+  struct MJPEG_FILE slot[FRAMES];
+  uint32_t head, tail;
+  bool held;
+  SemaphoreHandle_t mutex;
+} ring;
+
+static struct MJPEG_FILE *current;
 static int offset_counter;
 
-void mjpeg_frame_release() { xSemaphoreGive(xSemaphore); }
+/** a packet of the current frame got lost, waiting for the next interval */
+static bool resync;
+
+/** the last packet appended ended a restart interval */
+static bool interval_complete;
+
+/** quantization tables kept for reuse */
+#define QTABLES (4)
+
+/*
+ * Tables of Q values 1-127 (computed) and 128-254 (sent in band once).
+ * Q 255 tables change with every frame and are not kept.
+ */
+static struct {
+  uint8_t q; /* 0 if unused */
+  uint8_t lqt[64];
+  uint8_t cqt[64];
+} qtables[QTABLES];
+static int qtables_next;
+
+static int qtables_find(uint8_t q) {
+  for (int i = 0; i < QTABLES; i++)
+    if (qtables[i].q == q)
+      return i;
+  return -1;
+}
+
+static int qtables_store(uint8_t q, const uint8_t *lqt, const uint8_t *cqt) {
+  int i = qtables_find(q);
+  if (i < 0) {
+    i = qtables_next;
+    qtables_next = (qtables_next + 1) % QTABLES;
+  }
+  qtables[i].q = q;
+  memcpy(qtables[i].lqt, lqt, 64);
+  memcpy(qtables[i].cqt, cqt, 64);
+  return i;
+}
+
+/**
+ * get the oldest (or the newest, depending on the configuration) complete
+ * frame not decoded yet. This releases the frame returned by the last call.
+ */
+struct MJPEG_FILE *mjpeg_frame_next() {
+  uint32_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+  uint32_t tail = ring.tail + ring.held;
+  if (head == tail)
+    return NULL;
 
+#ifdef CONFIG_CONTROLLER_MJPEG_NEWEST
+  if (head - tail > 1) {
+    status_mjpeg_drop(STATUS_DROP_SKIPPED, head - tail - 1);
+    tail = head - 1;
+  }
+#endif
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  __atomic_store_n(&ring.tail, tail, __ATOMIC_RELEASE);
+  ring.held = true;
+  xSemaphoreGive(ring.mutex);
+  return &ring.slot[tail % FRAMES];
+}
+
+void mjpeg_frame_release() { xSemaphoreGive(ring.mutex); }
+
+/**
+ * lock the frame taken last by the decoder, e.g. to send it to a browser
+ */
 struct MJPEG_FILE *mjpeg_frame_access(TickType_t xTicksToWait) {
-  if (!xSemaphoreTake(xSemaphore, xTicksToWait))
+  if (!xSemaphoreTake(ring.mutex, xTicksToWait))
     return NULL;
 
-  if (last.size > 0)
-    return &last;
+  if (ring.held && ring.slot[ring.tail % FRAMES].size > 0)
+    return &ring.slot[ring.tail % FRAMES];
 
   mjpeg_frame_release();
   return NULL;
 }
 
+/**
+ * make sure that the frame being assembled can take size bytes
+ */
+static bool reserve_current(int size) {
+  if (size <= current->capacity)
+    return true;
+
+  if (size > MJPEG_MAX_SIZE) {
+    ESP_LOGE(TAG, "dropping mjpeg frame, too large");
+    status_mjpeg_drop(STATUS_DROP_TOO_LARGE, 1);
+    return false;
+  }
+
+  int capacity = (size + MJPEG_GROW_SIZE - 1) / MJPEG_GROW_SIZE *
+                 MJPEG_GROW_SIZE;
+  if (capacity > MJPEG_MAX_SIZE)
+    capacity = MJPEG_MAX_SIZE;
+  uint8_t *buffer = realloc(current->buffer, capacity);
+  if (buffer == NULL) {
+    ESP_LOGE(TAG, "dropping mjpeg frame, no memory for %d bytes", capacity);
+    status_mjpeg_drop(STATUS_DROP_NO_MEMORY, 1);
+    return false;
+  }
+  current->buffer = buffer;
+  current->capacity = capacity;
+  return true;
+}
+
+#ifdef CONFIG_CONTROLLER_MJPEG_NEWEST
+/**
+ * swap the new frame with the newest complete frame not taken by the decoder
+ * yet. Only the buffers are exchanged, so the older frame is dropped without
+ * copying. Fails if the decoder or the web server are busy with the ring.
+ */
+static bool replace_newest() {
+  bool replaced = false;
+
+  if (!xSemaphoreTake(ring.mutex, 0))
+    return false;
+  if (ring.head != ring.tail + ring.held) {
+    struct MJPEG_FILE *newest = &ring.slot[(ring.head - 1) % FRAMES];
+    struct MJPEG_FILE swap = *newest;
+    *newest = *current;
+    *current = swap;
+    replaced = true;
+  }
+  xSemaphoreGive(ring.mutex);
+  return replaced;
+}
+#endif
+
 static void finish_current() {
+  uint32_t tail = __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE);
 
-  if (!xSemaphoreTake(xSemaphore, 0)) {
-    status_mjpeg_loss(1);
-    ESP_LOGE(TAG, "dropping jpeg image of length %d", last.size);
-  } else {
-    last.decoded = false;
-    memcpy(&last, &current, sizeof(current));
-    xSemaphoreGive(xSemaphore);
-    if (remote_task)
-      xTaskNotifyGive(remote_task);
-    status_mjpeg_good();
+  if (ring.head + 1 - tail < FRAMES) {
+    status_mjpeg_good(current->copied);
+    __atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+    current = &ring.slot[ring.head % FRAMES];
+  }
+#ifdef CONFIG_CONTROLLER_MJPEG_NEWEST
+  else if (replace_newest()) {
+    status_mjpeg_drop(STATUS_DROP_SKIPPED, 1);
+    status_mjpeg_good(ring.slot[(ring.head - 1) % FRAMES].copied);
+  }
+#endif
+  else {
+    status_mjpeg_drop(STATUS_DROP_RING_FULL, 1);
+    ESP_LOGE(TAG, "dropping jpeg image of length %d", current->size);
+    return;
   }
+
+  if (remote_task)
+    xTaskNotifyGive(remote_task);
+}
+
+static void open_chunk(uint16_t interval) {
+  struct MJPEG_CHUNK *chunk = &current->chunk[current->chunks++];
+  chunk->interval = interval;
+  chunk->intervals = -1;
+  chunk->offset = current->size;
+}
+
+/**
+ * count the complete restart intervals of the last chunk. Each one is
+ * terminated by a restart marker, unless the packet ending it is the last one
+ * received.
+ */
+static void close_chunk() {
+  struct MJPEG_CHUNK *chunk = &current->chunk[current->chunks - 1];
+  const uint8_t *start = current->buffer + chunk->offset;
+  const uint8_t *end = current->buffer + current->size;
+  const uint8_t *p = start;
+  int intervals = 0;
+
+  while ((p = memchr(p, 0xff, end - p)) != NULL && p + 1 < end) {
+    if ((p[1] & 0xf8) == 0xd0) /* RST0 - RST7 */
+      intervals++;
+    p++;
+  }
+  if (interval_complete &&
+      (end - start < 2 || end[-2] != 0xff || (end[-1] & 0xf8) != 0xd0))
+    intervals++;
+  chunk->intervals = intervals;
+}
+
+/**
+ * hand over a frame with restart intervals although packets are missing.
+ * The decoder skips the lost intervals.
+ */
+static void finish_partial() {
+  if (!resync)
+    close_chunk();
+  resync = false;
+  offset_counter = -1;
+  current->partial = true;
+  ESP_LOGW(TAG, "partial jpeg image in %d chunks", current->chunks);
+  status_mjpeg_partial();
+  finish_current();
 }
 
 void mjpeg_on() {
-  current.size = 0;
-  last.size = 0;
-  current.decoded = false;
+  ring.head = ring.tail = 0;
+  ring.held = false;
+  for (int i = 0; i < FRAMES; i++) {
+    ring.slot[i].size = 0;
+    ring.slot[i].copied = 0;
+  }
+  current = &ring.slot[0];
   offset_counter = -1;
-  vSemaphoreCreateBinary(xSemaphore);
+  resync = false;
+  ring.mutex = xSemaphoreCreateMutex();
 }
 
-void mjpeg_off() { xSemaphoreGive(xSemaphore); }
+void mjpeg_off() {
+  vSemaphoreDelete(ring.mutex);
+  for (int i = 0; i < FRAMES; i++) {
+    free(ring.slot[i].buffer);
+    ring.slot[i].buffer = NULL;
+    ring.slot[i].capacity = 0;
+  }
+}
 
 int mjpeg_header_parse(uint8_t *buffer, int length, uint8_t start,
                        uint8_t end) {
@@ -116,6 +334,10 @@ int mjpeg_header_parse(uint8_t *buffer, int length, uint8_t start,
 			mjpegHeader->width * 8, mjpegHeader->height * 8);
 #endif
 
+  /* the end of the last frame got lost */
+  if (start && offset_counter >= 0 && current->restart)
+    finish_partial();
+
   if (start && mjpegHeader->fragmentOffset != 0) {
     ESP_LOGE(TAG, "Missing header, drop entire jpeg image");
     offset_counter = -1;
@@ -125,70 +347,160 @@ int mjpeg_header_parse(uint8_t *buffer, int length, uint8_t start,
   buffer += sizeof(struct rtp_mjpeg);
   length -= sizeof(struct rtp_mjpeg);
 
-  /* Parse the quantization table header. */
+  /* types 64-127 carry restart intervals */
+  uint16_t dri = 0, flc = 0;
+  if (mjpegHeader->type >= 64 && mjpegHeader->type < 128) {
+    if (length < sizeof(struct restartMarker)) {
+      ESP_LOGE(TAG, "short restart marker header %d", length);
+      status_mjpeg_error();
+      return -24;
+    }
+    struct restartMarker *restartHeader = (struct restartMarker *)buffer;
+    dri = ntohs(restartHeader->interval);
+    flc = ntohs(restartHeader->flc);
 
-  if (mjpegHeader->fragmentOffset != 0 &&
-      mjpegHeader->fragmentOffset != offset_counter) {
-    ESP_LOGE(TAG, "Lost segment, drop entire jpeg image %d %d",
-             mjpegHeader->fragmentOffset, offset_counter);
-    offset_counter = -1;
-    status_mjpeg_loss(1);
-    return -23;
+    buffer += sizeof(*restartHeader);
+    length -= sizeof(*restartHeader);
   }
 
-  /* Start of JPEG data packet. */
-  if (mjpegHeader->fragmentOffset == 0) {
+  if (resync || (mjpegHeader->fragmentOffset != 0 &&
+                 mjpegHeader->fragmentOffset != offset_counter)) {
+    if (offset_counter < 0 || !current->restart) {
+      ESP_LOGE(TAG, "Lost segment, drop entire jpeg image %d %d",
+               mjpegHeader->fragmentOffset, offset_counter);
+      offset_counter = -1;
+      status_mjpeg_loss(1);
+      return -23;
+    }
 
-    /* check for valid jpeg */
-    if (mjpegHeader->q != 255) {
-      ESP_LOGI(TAG, "Q value of %d not implemented", mjpegHeader->q);
-      status_mjpeg_error();
-      return -22;
+    if (!resync) {
+      ESP_LOGW(TAG, "Lost segment, skip to next restart interval %d %d",
+               mjpegHeader->fragmentOffset, offset_counter);
+      close_chunk();
+      current->partial = true;
+      resync = true;
+      status_mjpeg_loss(1);
     }
 
-    if (length < sizeof(struct quantizationTable)) {
-      ESP_LOGE(TAG, "short quantization table header %d", length);
-      status_mjpeg_error();
-      return -30;
+    /* continue with a packet starting a restart interval */
+    uint16_t count = flc & RESTART_COUNT;
+    if (!(flc & RESTART_FIRST) || count == RESTART_COUNT ||
+        mjpegHeader->fragmentOffset == 0 ||
+        current->chunks == MJPEG_CHUNKS) {
+      if (end)
+        finish_partial();
+      return 0;
     }
 
-    struct quantizationTable *qTableHeader = (struct quantizationTable *)buffer;
-    qTableHeader->len = ntohs(qTableHeader->len);
+    resync = false;
+    offset_counter = mjpegHeader->fragmentOffset;
+    open_chunk(count);
 
-    ESP_LOGV(TAG, "%08XL tbd %u prec %u len %u", *(uint32_t *)buffer,
-             qTableHeader->tbd, qTableHeader->precision, qTableHeader->len);
+    /* the decoder starts after the restart marker */
+    if (length >= 2 && buffer[0] == 0xff && (buffer[1] & 0xf8) == 0xd0) {
+      buffer += 2;
+      length -= 2;
+      offset_counter += 2;
+    }
+  }
 
-    if (qTableHeader->precision != 0 ||
-        qTableHeader->len > length - sizeof(*qTableHeader) ||
-        qTableHeader->len != 64) {
-      ESP_LOGE(TAG, "quantization table header invalid");
+  /* Start of JPEG data packet. */
+  if (mjpegHeader->fragmentOffset == 0) {
+
+    /* check for valid jpeg */
+    const uint8_t *lqt, *cqt;
+    if (mjpegHeader->q == 0) {
+      ESP_LOGI(TAG, "Q value of %d not allowed", mjpegHeader->q);
       status_mjpeg_error();
-      return -31;
+      return -22;
+    } else if (mjpegHeader->q < 128) {
+      int i = qtables_find(mjpegHeader->q);
+      if (i < 0) {
+        uint8_t l[64], c[64];
+        jpegtables(mjpegHeader->q, l, c);
+        i = qtables_store(mjpegHeader->q, l, c);
+      }
+      lqt = qtables[i].lqt;
+      cqt = qtables[i].cqt;
+    } else {
+      if (length < sizeof(struct quantizationTable)) {
+        ESP_LOGE(TAG, "short quantization table header %d", length);
+        status_mjpeg_error();
+        return -30;
+      }
+
+      struct quantizationTable *qTableHeader =
+          (struct quantizationTable *)buffer;
+      qTableHeader->len = ntohs(qTableHeader->len);
+
+      ESP_LOGV(TAG, "%08XL tbd %u prec %u len %u", *(uint32_t *)buffer,
+               qTableHeader->tbd, qTableHeader->precision, qTableHeader->len);
+
+      /* one table is used for luma and chroma */
+      if (qTableHeader->precision != 0 ||
+          qTableHeader->len > length - sizeof(*qTableHeader) ||
+          (qTableHeader->len != 64 && qTableHeader->len != 128 &&
+           (qTableHeader->len != 0 || mjpegHeader->q == 255))) {
+        ESP_LOGE(TAG, "quantization table header invalid");
+        status_mjpeg_error();
+        return -31;
+      }
+
+      if (qTableHeader->len == 0) {
+        int i = qtables_find(mjpegHeader->q);
+        if (i < 0) {
+          ESP_LOGE(TAG, "no quantization tables of Q %d", mjpegHeader->q);
+          status_mjpeg_error();
+          return -34;
+        }
+        lqt = qtables[i].lqt;
+        cqt = qtables[i].cqt;
+      } else {
+        lqt = qTableHeader->data;
+        cqt = qTableHeader->len == 128 ? lqt + 64 : lqt;
+        if (mjpegHeader->q != 255)
+          qtables_store(mjpegHeader->q, lqt, cqt);
+      }
+
+      buffer += qTableHeader->len + sizeof(*qTableHeader);
+      length -= qTableHeader->len + sizeof(*qTableHeader);
     }
 
     /* generated jpeg file header */
-    current.size = jpegfile(current.buffer, mjpegHeader->type,
-                            mjpegHeader->width, mjpegHeader->height,
-                            buffer + sizeof(struct quantizationTable));
-    assert(current.size <= sizeof(current.buffer));
+    offset_counter = -1;
+    if (!reserve_current(MJPEG_HEADER_SIZE))
+      return -32;
+    current->size = jpegfile(current->buffer, mjpegHeader->type & 63,
+                             mjpegHeader->width, mjpegHeader->height, lqt, cqt,
+                             dri);
+    assert(current->size <= MJPEG_HEADER_SIZE);
+    current->header = current->size;
+    current->format = jpegfile_format();
 
-    buffer += qTableHeader->len + sizeof(*qTableHeader);
-    length -= qTableHeader->len + sizeof(*qTableHeader);
     offset_counter = 0;
+    current->copied = 0;
+    current->restart = dri;
+    current->partial = false;
+    current->chunks = 0;
+    open_chunk(0);
   }
 
   /* append data */
-  if (current.size + length > sizeof(current.buffer)) {
-    ESP_LOGE(TAG, "dropping mjpeg frame, too large");
-    status_mjpeg_error();
+  if (!reserve_current(current->size + length)) {
+    offset_counter = -1;
     return -33;
   }
-  memcpy(current.buffer + current.size, buffer, length);
-  current.size += length;
+  memcpy(current->buffer + current->size, buffer, length);
+  current->size += length;
+  current->copied += length;
+  interval_complete = (flc & RESTART_LAST) != 0;
 
   /* test for end */
   offset_counter += length;
   if (offset_counter > 0 && end) {
+    if (current->partial)
+      status_mjpeg_partial();
+    offset_counter = -1;
     finish_current();
   }
   return 0;
@@ -14,14 +14,41 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <stdbool.h>
 #include <stdint.h>
 
 #define MJPEG_MAX_SIZE (40000)
 
+/** bytes reserved for the generated JPEG header */
+#define MJPEG_HEADER_SIZE (1024)
+
+/** frame buffers grow in steps of this size */
+#define MJPEG_GROW_SIZE (4096)
+
+/** maximal number of separately decodable parts of a frame */
+#define MJPEG_CHUNKS (32)
+
+/**
+ * consecutive restart intervals received without loss. The restart
+ * intervals of a frame that are not covered by any chunk are missing.
+ */
+struct MJPEG_CHUNK {
+  uint16_t interval; /* number of the first restart interval */
+  int16_t intervals; /* complete restart intervals, -1 up to the end */
+  int offset;        /* first byte of the entropy coded data */
+};
+
 struct MJPEG_FILE {
-  uint8_t buffer[MJPEG_MAX_SIZE];
+  uint8_t *buffer;
+  int capacity; /* allocated bytes of buffer */
   int size;
-  bool decoded;
+  int copied;       /* payload bytes copied into the buffer */
+  int header;       /* length of the JPEG headers */
+  uint32_t format;  /* equal for frames with the same JPEG headers */
+  uint16_t restart; /* MCUs per restart interval, 0 if none */
+  bool partial;     /* packets are missing */
+  int chunks;
+  struct MJPEG_CHUNK chunk[MJPEG_CHUNKS];
 };
 
 void mjpeg_on();
@@ -29,6 +56,7 @@ void mjpeg_off();
 
 int mjpeg_header_parse(uint8_t *buffer, int length, uint8_t start, uint8_t end);
 
+struct MJPEG_FILE *mjpeg_frame_next();
 struct MJPEG_FILE *mjpeg_frame_access(TickType_t xTicksToWait);
 void mjpeg_frame_release();
 void mjpeg_frame_wait_for_new();
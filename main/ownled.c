@@ -11,10 +11,15 @@
 
 #include "ownled.h"
 
-#include "controller.h"
-#include "driver/rmt.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "fastrmt.h"
+#include "freertos/FreeRTOS.h"
+#include "i2sled.h"
+#include "rmtled.h"
 #include "sdkconfig.h"
+#include "simled.h"
+#include "spiled.h"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,35 +29,26 @@
 #define RGB_BYTES_8 (1)
 #define RGB_BYTES_24 (3)
 #define RGB_BYTES_48 (6)
+#define RGBW_BYTES_32 (4)
 #define RGB_BITS_8 (RGB_BYTES_8 * 8)
 #define RGB_BITS_24 (RGB_BYTES_24 * 8)
 #define RGB_BITS_48 (RGB_BYTES_48 * 8)
 
 static const char *TAG = "#ownled";
 
-#define RMT_MEM_BLOCK_BYTE_NUM (4 * RMT_MEM_ITEM_NUM)
-
 /**
  *  define frequency,
  *  length of SLED impulses
  */
 
-/** Frequency of the quartz */
-#define FREQ_INPUT (8e7)
-
 /** Frequency of the SLED clock */
-#define DEFAULT_FREQ_OUTPUT (8e5)
+#define DEFAULT_FREQ_OUTPUT (800000)
 
-/** ticks per SLED clock period */
-#define DEFAULT_PULSE_LENGTH (FREQ_INPUT / DEFAULT_FREQ_OUTPUT)
+/** high impulse of the data bit "one" has the relative length of, in percent */
+#define DEFAULT_ONE_PULSE_LENGTH (60)
 
-/** high impulse of the data bit "one" has the relative length of */
-//#define DEFAULT_ONE_PULSE_LENGTH 0.60
-#define DEFAULT_ONE_PULSE_LENGTH (0.60)
-
-/** high impulse of the data bit "zero" has the relative length of */
-//#define DEFAULT_ZERO_PULSE_LENGTH 0.30
-#define DEFAULT_ZERO_PULSE_LENGTH (0.30)
+/** high impulse of the data bit "zero" has the relative length of, in percent */
+#define DEFAULT_ZERO_PULSE_LENGTH (30)
 
 /**
  * config data
@@ -60,89 +56,177 @@ static const char *TAG = "#ownled";
 
 static enum OWNLED_COLOR_ORDER color_order = OWNLED_GRB;
 
-/**
- * RMT structure for one (high) and zero (low) impulse initialized by default
- * values
- */
-IRAM_ATTR rmt_item32_t cs8812_high = {
-    .duration0 = DEFAULT_PULSE_LENGTH * DEFAULT_ONE_PULSE_LENGTH,
-    .level0 = 1,
-    .duration1 = DEFAULT_PULSE_LENGTH * (1 - DEFAULT_ONE_PULSE_LENGTH),
-    .level1 = 0};
-
-IRAM_ATTR rmt_item32_t cs8812_low = {
-    .duration0 = DEFAULT_PULSE_LENGTH * DEFAULT_ZERO_PULSE_LENGTH,
-    .level0 = 1,
-    .duration1 = DEFAULT_PULSE_LENGTH * (1 - DEFAULT_ZERO_PULSE_LENGTH),
-    .level1 = 0,
-};
+static uint32_t pulse_frequency = DEFAULT_FREQ_OUTPUT;
+static uint8_t pulse_one = DEFAULT_ONE_PULSE_LENGTH;
+static uint8_t pulse_zero = DEFAULT_ZERO_PULSE_LENGTH;
+
+/** output driver selected at ownled_init */
+static const struct OWNLED_DRIVER *driver;
+
+/** driver of the clocked lines */
+static const struct OWNLED_DRIVER *const clocked =
+#if CONFIG_CONTROLLER_LED_SPI
+    &spiled_driver;
+#else
+    NULL;
+#endif
+
+/** 5 bit global brightness of clocked LEDs */
+static uint8_t global_brightness = 31;
 
 /**
- * set the pulse length and widths
+ * timing of each line. Lines without an own timing follow the global pulses.
  */
-esp_err_t ownled_set_pulses(uint32_t frequency, uint8_t one, uint8_t zero) {
+static struct {
+  uint32_t frequency;
+  uint8_t one;
+  uint8_t zero;
+  bool own;
+} timing[OWNLED_MAXIMAL_LINES];
+
+static esp_err_t ownled_check_pulses(uint32_t frequency, uint8_t one,
+                                     uint8_t zero) {
   if (one < zero || one < 55 || one > 90 || zero < 10 || zero > 45)
     return ESP_ERR_INVALID_ARG;
   if (frequency * 2 < DEFAULT_FREQ_OUTPUT ||
       frequency * 0.67 > DEFAULT_FREQ_OUTPUT)
     return ESP_ERR_INVALID_ARG;
-
-  double factor = FREQ_INPUT / (frequency * 100.);
-  cs8812_high.duration0 = factor * one;
-  cs8812_high.duration1 = factor * (100 - one);
-  cs8812_low.duration0 = factor * zero;
-  cs8812_low.duration1 = factor * (100 - zero);
-
   return ESP_OK;
 }
 
-uint32_t ownled_get_pulse_frequency() {
-  double pulse_length = cs8812_high.duration0 + cs8812_high.duration1;
-  return 10000. * round(FREQ_INPUT / (pulse_length * 10000.));
+static void ownled_apply_pulses(uint8_t c) {
+  if (!timing[c].own) {
+    timing[c].frequency = pulse_frequency;
+    timing[c].one = pulse_one;
+    timing[c].zero = pulse_zero;
+  }
+  if (driver)
+    driver->set_pulses(c, timing[c].frequency, timing[c].one, timing[c].zero);
 }
 
-uint8_t ownled_get_pulse_one() {
-  double pulse_length = cs8812_high.duration0 + cs8812_high.duration1;
-  return round(cs8812_high.duration0 / pulse_length * 20.) * 5;
+/**
+ * set the pulse length and widths
+ */
+esp_err_t ownled_set_pulses(uint32_t frequency, uint8_t one, uint8_t zero) {
+  if (ownled_check_pulses(frequency, one, zero) != ESP_OK)
+    return ESP_ERR_INVALID_ARG;
+
+  pulse_frequency = frequency;
+  pulse_one = one;
+  pulse_zero = zero;
+  for (uint8_t i = 0; i < ownled_getChannels(); i++)
+    ownled_apply_pulses(i);
+
+  return ESP_OK;
 }
 
-uint8_t ownled_get_pulse_zero() {
-  float pulse_length = cs8812_high.duration0 + cs8812_high.duration1;
-  return round(cs8812_low.duration0 / pulse_length * 20.) * 5;
+uint32_t ownled_get_pulse_frequency() { return pulse_frequency; }
+
+uint8_t ownled_get_pulse_one() { return pulse_one; }
+
+uint8_t ownled_get_pulse_zero() { return pulse_zero; }
+
+/**
+ * set the timing of a single line, e.g. to run chips at their fastest rate. A
+ * frequency of zero returns the line to the global pulses.
+ */
+esp_err_t ownled_set_line_pulses(uint8_t channel, uint32_t frequency,
+                                 uint8_t one, uint8_t zero) {
+  if (channel >= ownled_getChannels())
+    return ESP_ERR_INVALID_ARG;
+  if (frequency != 0 && ownled_check_pulses(frequency, one, zero) != ESP_OK)
+    return ESP_ERR_INVALID_ARG;
+
+  timing[channel].own = frequency != 0;
+  timing[channel].frequency = frequency;
+  timing[channel].one = one;
+  timing[channel].zero = zero;
+  ownled_apply_pulses(channel);
+  return ESP_OK;
 }
 
 /**
- * fastrmt structure
+ * alloc the structure of the lines. Each line has two buffers: the front
+ * buffer is read by the driver while pixels are written into the back buffer.
  */
 
-#define MAXIMAL_LINES (8)
-#define BYTES_PER_LINE (616 * 3)
+#define MAXIMAL_LINES OWNLED_MAXIMAL_LINES
 
-extern struct FASTRMI_DATA {
-  uint16_t counter;
-  uint16_t length;
-  uint32_t baseAddress;
-  uint32_t mask;
-  uint32_t intmask;
-  uint8_t *input;
-} fastrmi_para[MAXIMAL_LINES];
+/**
+ * writes n pixels of a line. The pixels are at first + pos[i], or at first + i
+ * if pos is NULL. rgbw points to red, green, blue and white of the first pixel
+ * and advances by step bytes per pixel, so a step of zero writes one color.
+ */
+typedef void (*OWNLED_WRITER)(uint8_t c, const uint16_t *pos, uint16_t first,
+                              uint16_t n, const uint8_t *rgbw, uint8_t step);
 
-extern uint8_t fastrmi_bytes[BYTES_PER_LINE * MAXIMAL_LINES];
+static struct {
+  uint32_t numBytes;
+  uint16_t numPixels;
+  enum OWNLED_PROTOCOL protocol;
+  uint8_t *buffer[2];
+  uint8_t front;
+  uint32_t dirtyEnd; /* changed bytes of the back buffer, from the start */
+  OWNLED_WRITER write; /* matches the layout of the buffers */
+  uint8_t base;        /* offset of the first pixel in the buffers */
+  uint8_t unit;        /* bytes per pixel in the buffers */
+  uint32_t staleEnd;   /* bytes of the back buffer behind the front buffer */
+  uint32_t syncedEnd;  /* bytes of the stale ones already caught up */
+  uint32_t *redrawn;   /* stale pixels written since the swap, one bit each */
+} lines[MAXIMAL_LINES];
 
-extern int32_t _l5_counter, _l5_flags;
+static OWNLED_WRITER ownled_writer(uint8_t c);
 
-static intr_handle_t isr_handle;
+/**
+ * pixels are written by several tasks. The writers take the lock, so that no
+ * pixel is written while a line swaps or changes its buffers. It is held only
+ * for short times, as it masks the interrupts and blocks the other core.
+ */
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
 
 /**
- * alloc the structure for RMT handling
+ * After a swap, the back buffer misses the bytes changed in the last frame,
+ * up to staleEnd. Most sources redraw them anyway, so they are not copied at
+ * the swap. ownled_prepare copies only the stale pixels not redrawn since.
  */
+#define OWNLED_CATCH_UP (32) /* pixels caught up per locking */
 
-static struct {
-  rmt_channel_t rmtChannel;
-  uint16_t numBytes;
-  uint8_t *frameBuffer;
-  uint8_t *rmtBuffer;
-} lines[MAXIMAL_LINES];
+/**
+ * The LEDs keep their color until they get new data. Thus, a frame is sent
+ * only up to the last changed byte of a line. Every CONFIG_CONTROLLER_LED_
+ * FULL_REFRESH frames all lines are sent completely to recover from glitches.
+ */
+static uint16_t refresh_count;
+
+/**
+ * APA102 frame: 32 zero bits, 32 bits per LED, 32 zero bits to reset SK9822
+ * and a clock edge per two LEDs to shift the data through the strip.
+ */
+#define APA102_START (4)
+#define APA102_LED (4)
+#define APA102_END(n) (4 + ((n) + 15) / 16)
+
+static inline uint8_t *ownled_back(uint8_t c) {
+  return lines[c].buffer[lines[c].front ^ 1];
+}
+
+/**
+ * write the n bytes of a pixel at offset o into the back buffer. The dirty
+ * extent grows only if the pixel differs from the bytes sent last. A stale
+ * pixel, which is redrawn, needs no catching up anymore.
+ */
+static inline void ownled_store(uint8_t c, uint32_t o, const uint8_t *px,
+                                uint8_t n) {
+  if (o < lines[c].staleEnd && o >= lines[c].syncedEnd) {
+    uint32_t u = (o - lines[c].base) / n;
+    lines[c].redrawn[u / 32] |= 1U << (u % 32);
+  }
+  memcpy(ownled_back(c) + o, px, n);
+
+  if (o + n > lines[c].dirtyEnd &&
+      memcmp(lines[c].buffer[lines[c].front] + o, px, n) != 0)
+    lines[c].dirtyEnd = o + n;
+}
 
 /**
  * settings of different hardware
@@ -178,29 +262,65 @@ static const uint8_t version_gpio[CONFIG_CONTROLLER_LED_LINES] = {
     ,
     CONFIG_CONTROLLER_LED_LINE7
 #endif
+#if CONFIG_CONTROLLER_LED_LINES >= 9
+    ,
+    CONFIG_CONTROLLER_LED_LINE8
+#endif
+#if CONFIG_CONTROLLER_LED_LINES >= 10
+    ,
+    CONFIG_CONTROLLER_LED_LINE9
+#endif
+#if CONFIG_CONTROLLER_LED_LINES >= 11
+    ,
+    CONFIG_CONTROLLER_LED_LINE10
+#endif
+#if CONFIG_CONTROLLER_LED_LINES >= 12
+    ,
+    CONFIG_CONTROLLER_LED_LINE11
+#endif
+#if CONFIG_CONTROLLER_LED_LINES >= 13
+    ,
+    CONFIG_CONTROLLER_LED_LINE12
+#endif
+#if CONFIG_CONTROLLER_LED_LINES >= 14
+    ,
+    CONFIG_CONTROLLER_LED_LINE13
+#endif
+#if CONFIG_CONTROLLER_LED_LINES >= 15
+    ,
+    CONFIG_CONTROLLER_LED_LINE14
+#endif
+#if CONFIG_CONTROLLER_LED_LINES >= 16
+    ,
+    CONFIG_CONTROLLER_LED_LINE15
+#endif
 
 };
 
+/* lines 8 to 15 have no default GPIO, see Kconfig.projbuild */
+#if CONFIG_CONTROLLER_LED_LINE8 < 0 || CONFIG_CONTROLLER_LED_LINE9 < 0 ||      \
+    CONFIG_CONTROLLER_LED_LINE10 < 0 || CONFIG_CONTROLLER_LED_LINE11 < 0 ||    \
+    CONFIG_CONTROLLER_LED_LINE12 < 0 || CONFIG_CONTROLLER_LED_LINE13 < 0 ||    \
+    CONFIG_CONTROLLER_LED_LINE14 < 0 || CONFIG_CONTROLLER_LED_LINE15 < 0
+#error "set the GPIOs of all LED lines in menuconfig"
+#endif
+
 /*
  *
  */
 uint8_t ownled_getChannels() { return CONFIG_CONTROLLER_LED_LINES; }
 
-uint8_t ownled_getBlocksize() {
-  switch (CONFIG_CONTROLLER_LED_LINES) {
-  case 1:
-    return 8;
-  case 2:
-    return 4;
-  case 3:
-  case 4:
-    return 2;
-  default:
-    return 1;
-  }
+const struct OWNLED_DRIVER *ownled_default_driver() {
+#if CONFIG_CONTROLLER_LED_I2S
+  return &i2sled_driver;
+#elif CONFIG_CONTROLLER_LED_SIMULATOR
+  return &simled_driver;
+#else
+  return &rmtled_driver;
+#endif
 }
 
-void ownled_init() {
+void ownled_init(const struct OWNLED_DRIVER *drv) {
 
   if (ownled_getChannels() == 0)
     return;
@@ -208,40 +328,27 @@ void ownled_init() {
   //	ownled_set_default();
 
   for (uint8_t i = 0; i < ownled_getChannels(); i++) {
-
-    lines[i].rmtChannel = i * ownled_getBlocksize();
-    lines[i].frameBuffer = NULL;
+    lines[i].buffer[0] = lines[i].buffer[1] = NULL;
+    lines[i].front = 0;
+    lines[i].dirtyEnd = 0;
     lines[i].numBytes = 0;
-
-    rmt_config_t config = {.rmt_mode = RMT_MODE_TX,
-                           .channel = lines[i].rmtChannel,
-                           .clk_div = 1, // 80 MHz (APB CLK typical)
-                           .gpio_num = version_gpio[i],
-                           .mem_block_num = ownled_getBlocksize(),
-                           .tx_config = {
-                               .loop_en = false,
-                               .carrier_en = false,
-                               .carrier_freq_hz = 0,
-                               .carrier_duty_percent = 0,
-                               .carrier_level = RMT_CARRIER_LEVEL_HIGH,
-                               .idle_level = RMT_IDLE_LEVEL_LOW,
-                               .idle_output_en = true,
-                           }};
-
-    gpio_pad_select_gpio(version_gpio[i]);
-    gpio_set_level(version_gpio[i], 0);
-    gpio_set_direction(version_gpio[i], GPIO_MODE_OUTPUT);
-
-    ESP_ERROR_CHECK(rmt_config(&config));
-    ESP_ERROR_CHECK(
-        rmt_set_tx_thr_intr_en(lines[i].rmtChannel, true,
-                               ownled_getBlocksize() * RMT_MEM_ITEM_NUM / 2));
-    ESP_LOGD(TAG, "init %d config %d %p", i, version_gpio[i],
-             &RMT.tx_lim_ch[i]);
+    lines[i].numPixels = 0;
+    lines[i].protocol = OWNLED_WS281X;
+    lines[i].write = NULL;
+    lines[i].base = 0;
+    lines[i].unit = 1;
+    lines[i].staleEnd = lines[i].syncedEnd = 0;
+    lines[i].redrawn = NULL;
   }
-  ESP_ERROR_CHECK(esp_intr_alloc(ETS_RMT_INTR_SOURCE,
-                                 ESP_INTR_FLAG_LEVEL5 | ESP_INTR_FLAG_IRAM,
-                                 NULL, NULL, &isr_handle));
+
+  if (clocked)
+    ESP_ERROR_CHECK(clocked->init(version_gpio, ownled_getChannels()));
+
+  ESP_LOGI(TAG, "%s driver for %d lines", drv->name, ownled_getChannels());
+  ESP_ERROR_CHECK(drv->init(version_gpio, ownled_getChannels()));
+  driver = drv;
+  for (uint8_t i = 0; i < ownled_getChannels(); i++)
+    ownled_apply_pulses(i);
 }
 
 extern esp_err_t ownled_setColorOrder(enum OWNLED_COLOR_ORDER order) {
@@ -263,8 +370,13 @@ extern esp_err_t ownled_setColorOrder(enum OWNLED_COLOR_ORDER order) {
   case OWNLED_BW_FB:
   case OWNLED_48:
   case OWNLED_48_FB:
+  case OWNLED_RGBW:
+  case OWNLED_GRBW:
     color_order = order;
     ESP_LOGI(TAG, "set led order %d=%d", color_order, order);
+    for (uint8_t i = 0; i < MAXIMAL_LINES; i++)
+      if (lines[i].write)
+        lines[i].write = ownled_writer(i);
     return ESP_OK;
   }
   return ESP_ERR_INVALID_ARG;
@@ -276,188 +388,343 @@ enum OWNLED_COLOR_ORDER ownled_getColorOrder() {
 }
 
 void ownled_set_default() {
-  cs8812_high.duration0 = DEFAULT_PULSE_LENGTH * DEFAULT_ONE_PULSE_LENGTH;
-  cs8812_high.duration1 = DEFAULT_PULSE_LENGTH * (1 - DEFAULT_ONE_PULSE_LENGTH);
-  cs8812_low.duration0 = DEFAULT_PULSE_LENGTH * DEFAULT_ZERO_PULSE_LENGTH;
-  cs8812_low.duration1 = DEFAULT_PULSE_LENGTH * (1 - DEFAULT_ZERO_PULSE_LENGTH);
+  ownled_set_pulses(DEFAULT_FREQ_OUTPUT, DEFAULT_ONE_PULSE_LENGTH,
+                    DEFAULT_ZERO_PULSE_LENGTH);
   //	ESP_LOGI(TAG, "led order default %d", color_order);
   //	color_order = OWNLED_GRB;
 }
 
-extern void ownled_setBytes(uint8_t c, uint16_t pos, uint8_t sw) {
-  if (c >= MAXIMAL_LINES || pos >= lines[c].numBytes)
+extern void ownled_setBytes(uint8_t c, uint32_t pos, uint8_t sw) {
+  if (c >= MAXIMAL_LINES)
     return;
-  uint8_t *s = lines[c].frameBuffer;
-  if (s == NULL) {
-    s = lines[c].rmtBuffer;
+  /* only the bytes of the pixels, not the frames around them */
+  portENTER_CRITICAL(&lock);
+  uint32_t u = pos >= lines[c].base ? (pos - lines[c].base) / lines[c].unit
+                                    : lines[c].numPixels;
+  if (u < lines[c].numPixels) {
+    uint32_t o = lines[c].base + u * lines[c].unit;
+    const uint8_t *front = lines[c].buffer[lines[c].front];
+    uint8_t *back = ownled_back(c);
+
+    /* the other bytes of a stale pixel are caught up first */
+    if (o < lines[c].staleEnd && o >= lines[c].syncedEnd &&
+        !(lines[c].redrawn[u / 32] & (1U << (u % 32)))) {
+      memcpy(back + o, front + o, lines[c].unit);
+      lines[c].redrawn[u / 32] |= 1U << (u % 32);
+    }
+    back[pos] = sw;
+    if (pos + 1 > lines[c].dirtyEnd && front[pos] != sw)
+      lines[c].dirtyEnd = pos + 1;
   }
-  s[pos] = sw;
+  portEXIT_CRITICAL(&lock);
 }
 
-extern void ownled_setPixel(uint8_t c, uint16_t pos, uint8_t g, uint8_t b,
-                            uint8_t r) {
-  if (c >= MAXIMAL_LINES)
-    return;
+/**
+ * pack one pixel into px and return its offset in the line buffer. There is
+ * one function per color order, so that the order is not checked per pixel.
+ */
+#define OWNLED_PACK_24(order, i0, i1, i2)                                      \
+  static inline uint32_t ownled_pack_##order(uint8_t *px, uint32_t p,         \
+                                             const uint8_t *rgbw) {           \
+    px[0] = rgbw[i0];                                                          \
+    px[1] = rgbw[i1];                                                          \
+    px[2] = rgbw[i2];                                                          \
+    return p * RGB_BYTES_24;                                                   \
+  }
 
-  uint8_t *s = lines[c].frameBuffer;
-  if (s == NULL) {
-    s = lines[c].rmtBuffer;
+OWNLED_PACK_24(rgb, 0, 1, 2)
+OWNLED_PACK_24(rbg, 0, 2, 1)
+OWNLED_PACK_24(grb, 1, 0, 2)
+OWNLED_PACK_24(gbr, 1, 2, 0)
+OWNLED_PACK_24(brg, 2, 0, 1)
+OWNLED_PACK_24(bgr, 2, 1, 0)
+
+static inline uint32_t ownled_pack_bw(uint8_t *px, uint32_t p,
+                                      const uint8_t *rgbw) {
+  px[0] = (2126 * rgbw[0] + 7152 * rgbw[1] + 722 * rgbw[2]) / 10000;
+
+  switch (p % 12) /* warum? */
+  {
+  case 6:
+  case 9:
+    return p + 2;
+  case 8:
+  case 11:
+    return p - 2;
   }
+  return p;
+}
 
-  if (color_order == OWNLED_BW || color_order == OWNLED_BW_FB) {
-    if (pos >= lines[c].numBytes)
-      return;
-
-    s += pos;
-
-    switch (pos % 12) /* warum? */
-    {
-    case 6:
-    case 9:
-      s += 2;
-      break;
-    case 8:
-    case 11:
-      s -= 2;
-      break;
-    }
-  } else if (color_order == OWNLED_48 || color_order == OWNLED_48_FB) {
-    if (pos * RGB_BYTES_48 >= lines[c].numBytes)
-      return;
+static inline uint32_t ownled_pack_48(uint8_t *px, uint32_t p,
+                                      const uint8_t *rgbw) {
+  px[0] = lookupGamma[rgbw[0]] >> 8;
+  px[1] = lookupGamma[rgbw[0]];
+  px[2] = lookupGamma[rgbw[1]] >> 8;
+  px[3] = lookupGamma[rgbw[1]];
+  px[4] = lookupGamma[rgbw[2]] >> 8;
+  px[5] = lookupGamma[rgbw[2]];
+  return p * RGB_BYTES_48;
+}
 
-    s += pos * RGB_BYTES_48;
-  } else {
-    if (pos * RGB_BYTES_24 >= lines[c].numBytes)
-      return;
+static inline uint32_t ownled_pack_rgbw(uint8_t *px, uint32_t p,
+                                        const uint8_t *rgbw) {
+  px[0] = rgbw[0];
+  px[1] = rgbw[1];
+  px[2] = rgbw[2];
+  px[3] = rgbw[3];
+  return p * RGBW_BYTES_32;
+}
 
-    s += pos * RGB_BYTES_24;
-  }
+static inline uint32_t ownled_pack_grbw(uint8_t *px, uint32_t p,
+                                        const uint8_t *rgbw) {
+  px[0] = rgbw[1];
+  px[1] = rgbw[0];
+  px[2] = rgbw[2];
+  px[3] = rgbw[3];
+  return p * RGBW_BYTES_32;
+}
 
-  switch (color_order) {
-  case OWNLED_BW:
-  case OWNLED_BW_FB:
-    s[0] = (2126 * r + 7152 * g + 722 * b) / 10000;
-    break;
-  case OWNLED_48:
-  case OWNLED_48_FB:
-    s[0] = lookupGamma[r] >> 8;
-    s[1] = lookupGamma[r];
-    s[2] = lookupGamma[g] >> 8;
-    s[3] = lookupGamma[g];
-    s[4] = lookupGamma[b] >> 8;
-    s[5] = lookupGamma[b];
-    break;
-  case OWNLED_RGB:
-  case OWNLED_RGB_FB:
-    s[0] = r;
-    s[1] = g;
-    s[2] = b;
-    break;
-  case OWNLED_RBG:
-  case OWNLED_RBG_FB:
-    s[0] = r;
-    s[1] = b;
-    s[2] = g;
-    break;
-  case OWNLED_GRB:
-  case OWNLED_GRB_FB:
-    s[0] = g;
-    s[1] = r;
-    s[2] = b;
-    break;
-  case OWNLED_GBR:
-  case OWNLED_GBR_FB:
-    s[0] = g;
-    s[1] = b;
-    s[2] = r;
-    break;
-  case OWNLED_BRG:
-  case OWNLED_BRG_FB:
-    s[0] = b;
-    s[1] = r;
-    s[2] = g;
-    break;
-  case OWNLED_BGR:
-  case OWNLED_BGR_FB:
-    s[0] = b;
-    s[1] = g;
-    s[2] = r;
-    break;
+static inline uint32_t ownled_pack_apa102(uint8_t *px, uint32_t p,
+                                          const uint8_t *rgbw) {
+  px[0] = 0xE0 | global_brightness;
+  px[1] = rgbw[2];
+  px[2] = rgbw[1];
+  px[3] = rgbw[0];
+  return APA102_START + p * APA102_LED;
+}
+
+#define OWNLED_WRITER(order, bytes)                                            \
+  static void ownled_write_##order(uint8_t c, const uint16_t *pos,            \
+                                   uint16_t first, uint16_t n,                \
+                                   const uint8_t *rgbw, uint8_t step) {       \
+    uint8_t *s = ownled_back(c);                                               \
+    if (s == NULL)                                                             \
+      return;                                                                  \
+                                                                               \
+    for (uint16_t i = 0; i < n; i++, rgbw += step) {                           \
+      uint32_t p = first + (pos ? pos[i] : i);                                 \
+      uint8_t px[bytes];                                                       \
+      if (p >= lines[c].numPixels)                                             \
+        continue;                                                              \
+      uint32_t o = ownled_pack_##order(px, p, rgbw);                           \
+      if (o + bytes <= lines[c].numBytes)                                      \
+        ownled_store(c, o, px, bytes);                                         \
+    }                                                                          \
   }
+
+OWNLED_WRITER(rgb, RGB_BYTES_24)
+OWNLED_WRITER(rbg, RGB_BYTES_24)
+OWNLED_WRITER(grb, RGB_BYTES_24)
+OWNLED_WRITER(gbr, RGB_BYTES_24)
+OWNLED_WRITER(brg, RGB_BYTES_24)
+OWNLED_WRITER(bgr, RGB_BYTES_24)
+OWNLED_WRITER(bw, RGB_BYTES_8)
+OWNLED_WRITER(48, RGB_BYTES_48)
+OWNLED_WRITER(rgbw, RGBW_BYTES_32)
+OWNLED_WRITER(grbw, RGBW_BYTES_32)
+OWNLED_WRITER(apa102, APA102_LED)
+
+static const OWNLED_WRITER writers[] = {
+    [OWNLED_RGB] = ownled_write_rgb,   [OWNLED_RBG] = ownled_write_rbg,
+    [OWNLED_GRB] = ownled_write_grb,   [OWNLED_GBR] = ownled_write_gbr,
+    [OWNLED_BRG] = ownled_write_brg,   [OWNLED_BGR] = ownled_write_bgr,
+    [OWNLED_RGB_FB] = ownled_write_rgb, [OWNLED_RBG_FB] = ownled_write_rbg,
+    [OWNLED_GRB_FB] = ownled_write_grb, [OWNLED_GBR_FB] = ownled_write_gbr,
+    [OWNLED_BRG_FB] = ownled_write_brg, [OWNLED_BGR_FB] = ownled_write_bgr,
+    [OWNLED_BW] = ownled_write_bw,     [OWNLED_BW_FB] = ownled_write_bw,
+    [OWNLED_48] = ownled_write_48,     [OWNLED_48_FB] = ownled_write_48,
+    [OWNLED_RGBW] = ownled_write_rgbw, [OWNLED_GRBW] = ownled_write_grbw,
+};
+
+/**
+ * writer for the buffer layout of a line, selected when the size is set
+ */
+static OWNLED_WRITER ownled_writer(uint8_t c) {
+  if (lines[c].protocol == OWNLED_APA102)
+    return ownled_write_apa102;
+  return writers[color_order];
 }
 
-void ownled_send() {
-  int item_num = ownled_getBlocksize() * RMT_MEM_ITEM_NUM;
-  uint8_t bytesPre = item_num >> 3;
+extern void ownled_setPixel(uint8_t c, uint16_t pos, uint8_t g, uint8_t b,
+                            uint8_t r) {
+  if (c >= MAXIMAL_LINES)
+    return;
 
-  for (uint8_t i = 0; i < ownled_getChannels(); i++) {
-    if (lines[i].frameBuffer) {
-      memcpy(lines[i].rmtBuffer, lines[i].frameBuffer, lines[i].numBytes);
-    }
-  }
+  const uint8_t rgbw[4] = {r, g, b, 0};
+  portENTER_CRITICAL(&lock);
+  if (lines[c].write)
+    lines[c].write(c, NULL, pos, 1, rgbw, 0);
+  portEXIT_CRITICAL(&lock);
+}
 
-  for (uint8_t i = 0; i < ownled_getChannels(); i++) {
+bool ownled_hasWhite() {
+  return color_order == OWNLED_RGBW || color_order == OWNLED_GRBW;
+}
 
-    /** fill initial bytes int RMT buffer*/
-    uint8_t *src = lines[i].rmtBuffer;
-    if (src == NULL)
-      continue;
+/**
+ * whether the LEDs of a line have a white die. Clocked lines have none, they
+ * ignore the color order.
+ */
+bool ownled_lineHasWhite(uint8_t c) {
+  return c < MAXIMAL_LINES && lines[c].protocol != OWNLED_APA102 &&
+         ownled_hasWhite();
+}
 
-    rmt_item32_t *dst =
-        (void *)(0x3ff56800 + RMT_MEM_BLOCK_BYTE_NUM * lines[i].rmtChannel);
+/**
+ * set many pixels of a line with one call, see OWNLED_WRITER
+ */
+void ownled_setPixels(uint8_t c, const uint16_t *pos, uint16_t first,
+                      uint16_t n, const uint8_t *rgbw, uint8_t step) {
+  if (c >= MAXIMAL_LINES)
+    return;
 
-    ESP_LOGD(TAG, "%d %d %d %08X %08X %08X %d %d %p %p %p", _l5_counter, i,
-             lines[i].rmtChannel, _l5_flags, fastrmi_para[i].baseAddress,
-             fastrmi_para[i].mask, fastrmi_para[i].counter,
-             fastrmi_para[i].length, src, dst, &RMT.conf_ch[i]);
+  portENTER_CRITICAL(&lock);
+  if (lines[c].write)
+    lines[c].write(c, pos, first, n, rgbw, step);
+  portEXIT_CRITICAL(&lock);
+}
 
-    for (int8_t j = 0; j < bytesPre; j++) {
-      uint8_t s = *src++;
-      if (j == lines[i].numBytes) {
-        dst->val = 0;
+/**
+ * copy the stale pixels, which have not been redrawn since the last swap,
+ * from the front into the back buffers. The lock is taken for a few pixels at
+ * a time. Nothing is copied for lines redrawn completely.
+ */
+void ownled_prepare() {
+  for (uint8_t i = 0; i < ownled_getChannels(); i++) {
+    for (;;) {
+      portENTER_CRITICAL(&lock);
+      uint32_t o = lines[i].syncedEnd;
+      if (o >= lines[i].staleEnd) {
+        lines[i].staleEnd = lines[i].syncedEnd = 0;
+        portEXIT_CRITICAL(&lock);
         break;
       }
 
-      *dst++ = s & 0x80 ? cs8812_high : cs8812_low;
-      *dst++ = s & 0x40 ? cs8812_high : cs8812_low;
-      *dst++ = s & 0x20 ? cs8812_high : cs8812_low;
-      *dst++ = s & 0x10 ? cs8812_high : cs8812_low;
-      *dst++ = s & 0x08 ? cs8812_high : cs8812_low;
-      *dst++ = s & 0x04 ? cs8812_high : cs8812_low;
-      *dst++ = s & 0x02 ? cs8812_high : cs8812_low;
-      *dst++ = s & 0x01 ? cs8812_high : cs8812_low;
+      /* a whole word of the bitmap, starting at its first pixel */
+      uint8_t n = lines[i].unit;
+      uint32_t u = (o - lines[i].base) / n;
+      uint32_t redrawn = lines[i].redrawn[u / 32];
+      const uint8_t *front = lines[i].buffer[lines[i].front];
+      uint8_t *back = ownled_back(i);
+      for (int k = 0; k < OWNLED_CATCH_UP && o < lines[i].staleEnd;
+           k++, o += n)
+        if (!(redrawn & (1U << k)))
+          memcpy(back + o, front + o, n);
+      lines[i].redrawn[u / 32] = 0;
+      lines[i].syncedEnd = o;
+      portEXIT_CRITICAL(&lock);
     }
+  }
+}
 
-    /** fill remaining bytes into fastrmi buffer */
-    fastrmi_para[i].counter = bytesPre;
-    fastrmi_para[i].length = lines[i].numBytes;
-    fastrmi_para[i].baseAddress =
-        0x3ff56800 + RMT_MEM_BLOCK_BYTE_NUM * lines[i].rmtChannel;
-    fastrmi_para[i].mask = (ownled_getBlocksize() * RMT_MEM_BLOCK_BYTE_NUM) - 1;
-    fastrmi_para[i].intmask = 0x1000000 << lines[i].rmtChannel;
-    fastrmi_para[i].input = lines[i].rmtBuffer;
-
-    /** start transmitting */
-    ESP_ERROR_CHECK(rmt_tx_start(lines[i].rmtChannel, true));
+void ownled_send() {
+  uint32_t changed[MAXIMAL_LINES];
+  bool full = CONFIG_CONTROLLER_LED_FULL_REFRESH == 0 ||
+              ++refresh_count >= CONFIG_CONTROLLER_LED_FULL_REFRESH;
+  if (full)
+    refresh_count = 0;
+
+  /* nothing to do if the caller has prepared the lines already */
+  ownled_prepare();
+
+  /**
+   * show the back buffers if they have been changed. The new back buffers
+   * miss the changed bytes until they are redrawn or prepared.
+   */
+  for (uint8_t i = 0; i < ownled_getChannels(); i++) {
+    portENTER_CRITICAL(&lock);
+    changed[i] = lines[i].dirtyEnd;
+    if (changed[i] > 0) {
+      lines[i].dirtyEnd = 0;
+      lines[i].front ^= 1;
+      lines[i].staleEnd = changed[i];
+      lines[i].syncedEnd = lines[i].base;
+    }
+    portEXIT_CRITICAL(&lock);
   }
+
+  /** the clocked lines are sent by their own driver and always completely */
+  uint8_t *input[MAXIMAL_LINES], *clockedInput[MAXIMAL_LINES];
+  uint32_t length[MAXIMAL_LINES];
+  bool anyClocked = false;
+  for (uint8_t i = 0; i < ownled_getChannels(); i++) {
+    input[i] = clockedInput[i] = NULL;
+    if (lines[i].protocol == OWNLED_APA102) {
+      clockedInput[i] = lines[i].buffer[lines[i].front];
+      anyClocked = true;
+      length[i] = lines[i].numBytes;
+    } else {
+      input[i] = lines[i].buffer[lines[i].front];
+      length[i] = full ? lines[i].numBytes : changed[i];
+    }
+  }
+  if (driver)
+    driver->send(input, length);
+  if (anyClocked)
+    clocked->send(clockedInput, length);
 }
 
 esp_err_t ownled_isFinished() {
-  for (uint8_t i = 0; i < ownled_getChannels(); i++) {
-    if (fastrmi_para[i].length != 0 &&
-        fastrmi_para[i].counter < fastrmi_para[i].length)
-      return ESP_ERR_TIMEOUT;
+  if (clocked && clocked->isFinished() != ESP_OK)
+    return ESP_ERR_TIMEOUT;
+  return driver ? driver->isFinished() : ESP_OK;
+}
+
+static void ownled_stop() {
+  if (driver)
+    driver->stop();
+  if (clocked)
+    clocked->stop();
+}
+
+/**
+ * change the protocol of a line. The size has to be set again afterwards.
+ */
+esp_err_t ownled_setProtocol(uint8_t channel, enum OWNLED_PROTOCOL protocol) {
+  if (channel >= ownled_getChannels())
+    return ESP_ERR_INVALID_ARG;
+  if (lines[channel].protocol == protocol)
+    return ESP_OK;
+  if (protocol == OWNLED_APA102 && clocked == NULL)
+    return ESP_ERR_NOT_SUPPORTED;
+
+  ownled_stop();
+  esp_err_t res = ESP_OK;
+  if (protocol == OWNLED_APA102) {
+    res = clocked->attach(channel, version_gpio[channel]);
+  } else {
+    clocked->detach(channel);
+    if (driver && driver->attach)
+      res = driver->attach(channel, version_gpio[channel]);
+  }
+  if (res != ESP_OK) {
+    ESP_LOGE(TAG, "cannot change protocol of line %d: %d", channel, res);
+    return res;
   }
+  ESP_LOGI(TAG, "line %d protocol %d", channel, protocol);
+  lines[channel].protocol = protocol;
   return ESP_OK;
 }
 
+/**
+ * set the global brightness of clocked LEDs from 0 to 31. It is written with
+ * each pixel, thus pixels keep the brightness they have been colored for.
+ */
+void ownled_setGlobalBrightness(uint8_t level) {
+  global_brightness = level > 31 ? 31 : level;
+}
+
 void ownled_setSize(uint8_t channel, uint16_t _numPixels) {
-  uint16_t numBytes = 0;
+  uint32_t numBytes = 0;
 
   if (channel >= ownled_getChannels())
     return;
 
-  free(lines[channel].frameBuffer);
+  if (_numPixels > FASTRMT_MAXIMAL_LEDS) {
+    ESP_LOGE(TAG, "line %d too long %d", channel, _numPixels);
+    _numPixels = FASTRMT_MAXIMAL_LEDS;
+  }
+
   switch (color_order) {
   case OWNLED_RGB:
   case OWNLED_RBG:
@@ -465,17 +732,6 @@ void ownled_setSize(uint8_t channel, uint16_t _numPixels) {
   case OWNLED_GBR:
   case OWNLED_BRG:
   case OWNLED_BGR:
-    lines[channel].frameBuffer = NULL;
-    numBytes = _numPixels * RGB_BYTES_24;
-    break;
-  case OWNLED_BW:
-    lines[channel].frameBuffer = NULL;
-    numBytes = _numPixels * RGB_BYTES_8;
-    break;
-  case OWNLED_48:
-    lines[channel].frameBuffer = NULL;
-    numBytes = _numPixels * RGB_BYTES_48;
-    break;
   case OWNLED_RGB_FB:
   case OWNLED_RBG_FB:
   case OWNLED_GRB_FB:
@@ -483,46 +739,122 @@ void ownled_setSize(uint8_t channel, uint16_t _numPixels) {
   case OWNLED_BRG_FB:
   case OWNLED_BGR_FB:
     numBytes = _numPixels * RGB_BYTES_24;
-    lines[channel].frameBuffer = malloc(numBytes);
-    memset(lines[channel].frameBuffer, 0, numBytes);
     break;
+  case OWNLED_BW:
+  case OWNLED_BW_FB:
+    numBytes = _numPixels * RGB_BYTES_8;
+    break;
+  case OWNLED_48:
   case OWNLED_48_FB:
     numBytes = _numPixels * RGB_BYTES_48;
-    lines[channel].frameBuffer = malloc(numBytes);
-    memset(lines[channel].frameBuffer, 0, numBytes);
     break;
-  case OWNLED_BW_FB:
-    numBytes = _numPixels * RGB_BYTES_8;
-    lines[channel].frameBuffer = malloc(numBytes);
-    memset(lines[channel].frameBuffer, 0, numBytes);
+  case OWNLED_RGBW:
+  case OWNLED_GRBW:
+    numBytes = _numPixels * RGBW_BYTES_32;
     break;
   }
+  uint8_t base = 0, unit = _numPixels > 0 ? numBytes / _numPixels : 1;
+  uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+  if (lines[channel].protocol == OWNLED_APA102 && _numPixels > 0) {
+    numBytes =
+        APA102_START + _numPixels * APA102_LED + APA102_END(_numPixels);
+    numBytes = (numBytes + 3) & ~3; /* whole words for DMA */
+    base = APA102_START;
+    unit = APA102_LED;
+    caps |= MALLOC_CAP_DMA; /* read by the SPI unit */
+  }
+
+  /* the new buffers are ready before the writers see them */
+  uint8_t *buffer[2] = {NULL, NULL};
+  uint32_t *redrawn = NULL;
+  if (numBytes > 0) {
+    for (int i = 0; i < 2; i++) {
+      buffer[i] = heap_caps_calloc(numBytes, 1, caps);
+      if (buffer[i] == NULL)
+        break;
+      if (lines[channel].protocol == OWNLED_APA102) {
+        for (uint16_t p = 0; p < _numPixels; p++) // dark but valid LED frames
+          buffer[i][APA102_START + p * APA102_LED] = 0xE0;
+      } else
+        buffer[i][0] = 0x01; // sync bit in prefix leds
+    }
+    redrawn = calloc((_numPixels + 31) / 32, sizeof(uint32_t));
+    if (buffer[1] == NULL || redrawn == NULL) {
+      ESP_LOGE(TAG, "no memory for line %d", channel);
+      heap_caps_free(buffer[0]);
+      heap_caps_free(buffer[1]);
+      free(redrawn);
+      buffer[0] = buffer[1] = NULL;
+      redrawn = NULL;
+      numBytes = 0;
+      _numPixels = 0;
+    }
+  }
 
-  if (numBytes > BYTES_PER_LINE)
-    numBytes = BYTES_PER_LINE;
+  /* the driver must not read the buffers anymore */
+  ownled_stop();
+
+  portENTER_CRITICAL(&lock);
+  uint8_t *old[2] = {lines[channel].buffer[0], lines[channel].buffer[1]};
+  uint32_t *oldRedrawn = lines[channel].redrawn;
+  lines[channel].buffer[0] = buffer[0];
+  lines[channel].buffer[1] = buffer[1];
+  lines[channel].redrawn = redrawn;
+  lines[channel].front = 0;
+  lines[channel].dirtyEnd = 0;
+  lines[channel].staleEnd = lines[channel].syncedEnd = 0;
+  lines[channel].base = base;
+  lines[channel].unit = unit;
   lines[channel].numBytes = numBytes;
-  if(lines[channel].frameBuffer)
-    lines[channel].frameBuffer[0] = 0x01;   // sync bit in prefix leds
+  lines[channel].numPixels = _numPixels;
+  lines[channel].write = numBytes > 0 ? ownled_writer(channel) : NULL;
+  portEXIT_CRITICAL(&lock);
+
+  /* no writer can use the old buffers anymore */
+  heap_caps_free(old[0]);
+  heap_caps_free(old[1]);
+  free(oldRedrawn);
+  ESP_LOGD(TAG, "buffers %p %p %d", buffer[0], buffer[1], numBytes);
+}
 
-  /* TODO Warum der Scheiss hier? */
-  int blocksize = ownled_getBlocksize() * BYTES_PER_LINE;
-  lines[channel].rmtBuffer = fastrmi_bytes + blocksize * channel;
-  ESP_LOGD(TAG, "rmtBuffer %p %p %d", fastrmi_bytes, lines[channel].rmtBuffer,
-           blocksize);
-  memset(lines[channel].rmtBuffer, 0, blocksize);
-  lines[channel].rmtBuffer[0] = 0x01; // sync bit in prefix leds
+uint16_t ownled_getSize(uint8_t channel) {
+  return channel < ownled_getChannels() ? lines[channel].numPixels : 0;
+}
 
+/**
+ * let the driver distribute its resources, e.g. the RMT memory, after the sizes
+ * of the lines have been changed. Clocked lines do not need the driver.
+ */
+void ownled_updateLayout() {
+  uint32_t size[MAXIMAL_LINES];
+
+  for (uint8_t i = 0; i < ownled_getChannels(); i++)
+    size[i] = lines[i].protocol == OWNLED_WS281X ? lines[i].numBytes : 0;
+  ownled_stop();
+  if (driver && driver->set_sizes)
+    driver->set_sizes(size);
 }
 
 void ownled_free() {
+  if (driver)
+    driver->free();
+  if (clocked)
+    clocked->free();
+  driver = NULL;
   for (uint8_t i = 0; i < ownled_getChannels(); i++) {
-    rmt_tx_stop(lines[i].rmtChannel);
-    ESP_LOGD(TAG, "free %d %d", i, lines[i].rmtChannel);
-    ESP_ERROR_CHECK(rmt_set_tx_thr_intr_en(lines[i].rmtChannel, false, 0));
-    ESP_ERROR_CHECK(rmt_set_tx_intr_en(lines[i].rmtChannel, false));
-    free(lines[i].frameBuffer);
-    lines[i].frameBuffer = NULL;
+    portENTER_CRITICAL(&lock);
+    uint8_t *old[2] = {lines[i].buffer[0], lines[i].buffer[1]};
+    uint32_t *oldRedrawn = lines[i].redrawn;
+    lines[i].buffer[0] = lines[i].buffer[1] = NULL;
+    lines[i].redrawn = NULL;
     lines[i].numBytes = 0;
+    lines[i].numPixels = 0;
+    lines[i].staleEnd = lines[i].syncedEnd = lines[i].dirtyEnd = 0;
+    lines[i].write = NULL;
+    portEXIT_CRITICAL(&lock);
+
+    heap_caps_free(old[0]);
+    heap_caps_free(old[1]);
+    free(oldRedrawn);
   }
-  rmt_isr_deregister(isr_handle);
 }
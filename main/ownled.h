@@ -13,26 +13,67 @@
 #define MAIN_OWNLED_C_
 
 #include "esp_system.h"
+#include <stdbool.h>
 #include <stdint.h>
 
-extern void ownled_init();
+#define OWNLED_MAXIMAL_LINES (16)
+
+/**
+ * output driver sending the byte streams of all lines. Lines without data have
+ * a NULL input or a length of zero.
+ */
+struct OWNLED_DRIVER {
+  const char *name;
+  esp_err_t (*init)(const uint8_t *gpio, uint8_t lines);
+  /** timing of the single wire protocol of a line */
+  void (*set_pulses)(uint8_t line, uint32_t frequency, uint8_t one,
+                     uint8_t zero);
+  void (*send)(uint8_t *const *input, const uint32_t *length);
+  esp_err_t (*isFinished)();
+  void (*stop)();
+  void (*free)();
+  /** route the GPIO of a line to the driver (optional) */
+  esp_err_t (*attach)(uint8_t line, uint8_t gpio);
+  /** release the GPIO of a line (optional) */
+  void (*detach)(uint8_t line);
+  /** distribute resources by the sizes of the lines in bytes (optional) */
+  void (*set_sizes)(const uint32_t *size);
+};
+
+/** serial protocol of a line */
+enum OWNLED_PROTOCOL {
+  OWNLED_WS281X = 0, /* single wire, sent by the selected output driver */
+  OWNLED_APA102      /* clocked APA102 or SK9822, sent via SPI */
+};
+
+extern const struct OWNLED_DRIVER *ownled_default_driver();
+extern void ownled_init(const struct OWNLED_DRIVER *driver);
 extern void ownled_prepare();
 extern void ownled_send();
 extern esp_err_t ownled_isFinished();
 extern void ownled_free();
-extern void ownled_setByte(uint8_t c, uint16_t pos, uint8_t sw);
+extern void ownled_setBytes(uint8_t c, uint32_t pos, uint8_t sw);
 extern void ownled_setPixel(uint8_t c, uint16_t pos, uint8_t r, uint8_t g,
                             uint8_t b);
 extern uint8_t ownled_getChannels();
 extern void ownled_setSize(uint8_t channel, uint16_t numPixel);
+extern uint16_t ownled_getSize(uint8_t channel);
+extern void ownled_updateLayout();
+extern esp_err_t ownled_setProtocol(uint8_t channel,
+                                    enum OWNLED_PROTOCOL protocol);
+extern void ownled_setGlobalBrightness(uint8_t level);
 
 esp_err_t ownled_set_pulses(uint32_t frequency, uint8_t one, uint8_t zero);
 uint32_t ownled_get_pulse_frequency();
 uint8_t ownled_get_pulse_one();
 uint8_t ownled_get_pulse_zero();
+esp_err_t ownled_set_line_pulses(uint8_t channel, uint32_t frequency,
+                                 uint8_t one, uint8_t zero);
 
 void ownled_set_default();
 
+/* all orders are double buffered, the _FB variants are kept for compatibility
+ * with stored configurations */
 enum OWNLED_COLOR_ORDER {
   OWNLED_RGB = 0,
   OWNLED_RBG,
@@ -49,9 +90,15 @@ enum OWNLED_COLOR_ORDER {
   OWNLED_BW,
   OWNLED_BW_FB,
   OWNLED_48,
-  OWNLED_48_FB
+  OWNLED_48_FB,
+  OWNLED_RGBW, /* 32 bit with white channel, e.g. SK6812 */
+  OWNLED_GRBW
 };
 extern enum OWNLED_COLOR_ORDER ownled_getColorOrder();
 extern esp_err_t ownled_setColorOrder(enum OWNLED_COLOR_ORDER order);
+extern bool ownled_hasWhite();
+extern bool ownled_lineHasWhite(uint8_t c);
+extern void ownled_setPixels(uint8_t c, const uint16_t *pos, uint16_t first,
+                             uint16_t n, const uint8_t *rgbw, uint8_t step);
 
 #endif /* MAIN_OWNLED_C_ */
@@ -20,10 +20,12 @@
 
 //------------------------------------------------------------------------------
 #include <stdint.h>
+#include <string.h>
 typedef uint8_t uint8;
 typedef uint16_t uint16;
 typedef int8_t int8;
 typedef int16_t int16;
+typedef uint32_t uint32;
 //------------------------------------------------------------------------------
 #if PJPG_RIGHT_SHIFT_IS_ALWAYS_UNSIGNED
 static int16 replicateSignBit16(int8 n) {
@@ -166,10 +168,16 @@ static int16 gQuant1[8 * 8];
 // 6 bytes
 static int16 gLastDC[3];
 
+// Codes of up to this length are decoded with a single table lookup.
+#define PJPG_HUFF_LOOKUP_BITS 9
+
 typedef struct HuffTableT {
   uint16 mMinCode[16];
   uint16 mMaxCode[16];
   uint8 mValPtr[16];
+  // Code length (high byte) and value (low byte) indexed by the next
+  // PJPG_HUFF_LOOKUP_BITS bits, or 0 if the code is longer.
+  uint16 mLookup[1 << PJPG_HUFF_LOOKUP_BITS];
 } HuffTable;
 
 // DC - 192
@@ -187,6 +195,11 @@ static uint8 gHuffVal2[256];
 static HuffTable gHuffTab3;
 static uint8 gHuffVal3[256];
 
+// AC coefficients decoded together with their extra bits: value (high byte),
+// run (bits 4-7) and number of bits (low nibble), or 0 if not possible.
+static int16 gFastAC2[1 << PJPG_HUFF_LOOKUP_BITS];
+static int16 gFastAC3[1 << PJPG_HUFF_LOOKUP_BITS];
+
 static uint8 gValidHuffTables;
 static uint8 gValidQuantTables;
 
@@ -198,6 +211,15 @@ static uint8 gInBufLeft;
 
 static uint16 gBitBuf;
 static uint8 gBitsLeft;
+
+// Entropy coded data is read through a left aligned 32 bit accumulator.
+static uint32 gBitAcc;
+static uint8 gBitCnt;
+
+// Input read directly from memory instead of through the callback.
+static uint8 gInMemory;
+static const uint8 *gInPtr;
+static const uint8 *gInEnd;
 //------------------------------------------------------------------------------
 static uint16 gImageXSize;
 static uint16 gImageYSize;
@@ -230,6 +252,11 @@ static pjpeg_need_bytes_callback_t g_pNeedBytesCallback;
 static void *g_pCallback_data;
 static uint8 gCallbackStatus;
 static uint8 gReduce;
+// Width of the reduced blocks and the bits of the positions in gCoeffBuf,
+// which are set for the coefficients not needed by the reduced IDCT
+static uint8 gReduceSize;
+static uint8 gReduceMask;
+static uint8 gHeaderValid;
 //------------------------------------------------------------------------------
 static void fillInBuf(void) {
   unsigned char status;
@@ -251,6 +278,13 @@ static void fillInBuf(void) {
 }
 //------------------------------------------------------------------------------
 static PJPG_INLINE uint8 getChar(void) {
+  if (gInMemory) {
+    if (gInPtr != gInEnd)
+      return *gInPtr++;
+    gTemFlag = ~gTemFlag;
+    return gTemFlag ? 0xFF : 0xD9;
+  }
+
   if (!gInBufLeft) {
     fillInBuf();
     if (!gInBufLeft) {
@@ -264,6 +298,12 @@ static PJPG_INLINE uint8 getChar(void) {
 }
 //------------------------------------------------------------------------------
 static PJPG_INLINE void stuffChar(uint8 i) {
+  // Only the chars just read are put back.
+  if (gInMemory) {
+    gInPtr--;
+    return;
+  }
+
   gInBufOfs--;
   gInBuf[gInBufOfs] = i;
   gInBufLeft++;
@@ -320,23 +360,81 @@ static PJPG_INLINE uint16 getBits1(uint8 numBits) {
   return getBits(numBits, 0);
 }
 //------------------------------------------------------------------------------
-static PJPG_INLINE uint16 getBits2(uint8 numBits) {
-  return getBits(numBits, 1);
+// Returns the next byte of entropy coded data without the stuffed zero bytes.
+// At a marker or at the end of the data, zeros are returned and the marker
+// stays in the input.
+static uint8 getScanByte(void) {
+  uint8 c;
+
+  if (!gInMemory) {
+    c = getChar();
+    if (c == 0xFF) {
+      uint8 n = getChar();
+      if (n) {
+        stuffChar(n);
+        stuffChar(0xFF);
+        return 0;
+      }
+    }
+    return c;
+  }
+
+  if (gInPtr == gInEnd)
+    return 0;
+  c = *gInPtr;
+  if (c == 0xFF) {
+    if ((gInEnd - gInPtr < 2) || gInPtr[1])
+      return 0;
+    gInPtr++;
+  }
+  gInPtr++;
+  return c;
 }
 //------------------------------------------------------------------------------
-static PJPG_INLINE uint8 getBit(void) {
-  uint8 ret = 0;
-  if (gBitBuf & 0x8000)
-    ret = 1;
+// Tops up the bit accumulator to more than 24 bits a byte at a time.
+static void fillBitsSlow(void) {
+  do {
+    gBitAcc |= (uint32)getScanByte() << (24 - gBitCnt);
+    gBitCnt += 8;
+  } while (gBitCnt <= 24);
+}
+//------------------------------------------------------------------------------
+// Tops up the bit accumulator to more than 24 bits. From memory, up to four
+// bytes are added at once if none of them is 0xFF.
+static PJPG_INLINE void fillBits(void) {
+  if (gInMemory && (gInEnd - gInPtr >= 4)) {
+    uint32 w = ((uint32)gInPtr[0] << 24) | ((uint32)gInPtr[1] << 16) |
+               ((uint32)gInPtr[2] << 8) | gInPtr[3];
 
-  if (!gBitsLeft) {
-    gBitBuf |= getOctet(1);
+    if (!((~w - 0x01010101) & w & 0x80808080)) {
+      uint8 n = (uint8)((32 - gBitCnt) >> 3);
 
-    gBitsLeft += 8;
+      gBitAcc |= (w >> (32 - 8 * n)) << (32 - 8 * n - gBitCnt);
+      gInPtr += n;
+      gBitCnt = (uint8)(gBitCnt + 8 * n);
+      return;
+    }
   }
 
-  gBitsLeft--;
-  gBitBuf <<= 1;
+  fillBitsSlow();
+}
+//------------------------------------------------------------------------------
+static void startBits(void) {
+  gBitAcc = 0;
+  gBitCnt = 0;
+  fillBits();
+}
+//------------------------------------------------------------------------------
+// Reads 1 to 16 bits of entropy coded data.
+static PJPG_INLINE uint16 getBits2(uint8 numBits) {
+  uint16 ret;
+
+  if (gBitCnt < numBits)
+    fillBits();
+
+  ret = (uint16)(gBitAcc >> (32 - numBits));
+  gBitAcc <<= numBits;
+  gBitCnt = (uint8)(gBitCnt - numBits);
 
   return ret;
 }
@@ -400,18 +498,35 @@ static PJPG_INLINE int16 huffExtend(uint16 x, uint8 s) {
 //------------------------------------------------------------------------------
 static PJPG_INLINE uint8 huffDecode(const HuffTable *pHuffTable,
                                     const uint8 *pHuffVal) {
-  uint8 i = 0;
+  uint8 i = PJPG_HUFF_LOOKUP_BITS;
   uint8 j;
-  uint16 code = getBit();
+  uint32 bits;
+  uint16 code, lookup;
+
+  // A code has up to 16 bits, one more is read if it is invalid.
+  if (gBitCnt < 17)
+    fillBits();
+
+  lookup = pHuffTable->mLookup[gBitAcc >> (32 - PJPG_HUFF_LOOKUP_BITS)];
+  if (lookup) {
+    uint8 length = (uint8)(lookup >> 8);
+
+    gBitAcc <<= length;
+    gBitCnt = (uint8)(gBitCnt - length);
+
+    return (uint8)lookup;
+  }
+
+  // Longer codes are searched a bit at a time.
+  bits = gBitAcc;
+  code = (uint16)(bits >> (31 - PJPG_HUFF_LOOKUP_BITS));
+  bits <<= PJPG_HUFF_LOOKUP_BITS + 1;
 
-  // This func only reads a bit at a time, which on modern CPU's is not terribly
-  // efficient. But on microcontrollers without strong integer shifting support
-  // this seems like a more reasonable approach.
   for (;;) {
     uint16 maxCode;
 
     if (i == 16)
-      return 0;
+      break;
 
     maxCode = pHuffTable->mMaxCode[i];
     if ((code <= maxCode) && (maxCode != 0xFFFF))
@@ -419,20 +534,28 @@ static PJPG_INLINE uint8 huffDecode(const HuffTable *pHuffTable,
 
     i++;
     code <<= 1;
-    code |= getBit();
+    code |= (uint16)(bits >> 31);
+    bits <<= 1;
   }
 
+  gBitAcc = bits;
+  gBitCnt = (uint8)(gBitCnt - i - 1);
+  if (i == 16)
+    return 0;
+
   j = pHuffTable->mValPtr[i];
   j = (uint8)(j + (code - pHuffTable->mMinCode[i]));
 
   return pHuffVal[j];
 }
 //------------------------------------------------------------------------------
-static void huffCreate(const uint8 *pBits, HuffTable *pHuffTable) {
+static void huffCreate(const uint8 *pBits, const uint8 *pHuffVal,
+                       uint16 count, HuffTable *pHuffTable) {
   uint8 i = 0;
   uint8 j = 0;
 
   uint16 code = 0;
+  uint16 index;
 
   for (;;) {
     uint8 num = pBits[i];
@@ -457,6 +580,72 @@ static void huffCreate(const uint8 *pBits, HuffTable *pHuffTable) {
     if (i > 15)
       break;
   }
+
+  // Decode each combination of the next bits the same way as huffDecode()
+  // searches for a code. The combinations matching a length follow the ones
+  // matching the shorter lengths.
+  index = 0;
+  for (i = 0; i < PJPG_HUFF_LOOKUP_BITS; i++) {
+    uint16 maxCode = pHuffTable->mMaxCode[i];
+    uint8 shift = (uint8)(PJPG_HUFF_LOOKUP_BITS - 1 - i);
+
+    if (maxCode == 0xFFFF)
+      continue;
+
+    for (; (index < (1 << PJPG_HUFF_LOOKUP_BITS)) &&
+           ((index >> shift) <= maxCode);
+         index++) {
+      code = index >> shift;
+      j = (uint8)(pHuffTable->mValPtr[i] + (code - pHuffTable->mMinCode[i]));
+      pHuffTable->mLookup[index] =
+          (j < count) ? (uint16)(((i + 1) << 8) | pHuffVal[j]) : 0;
+    }
+  }
+
+  for (; index < (1 << PJPG_HUFF_LOOKUP_BITS); index++)
+    pHuffTable->mLookup[index] = 0;
+}
+//------------------------------------------------------------------------------
+// Finds the AC codes that fit into the lookup together with their extra bits
+// and a value from -128 to 127.
+static void fastACCreate(const HuffTable *pHuffTable, int16 *pFastAC) {
+  uint16 index;
+
+  for (index = 0; index < (1 << PJPG_HUFF_LOOKUP_BITS); index++) {
+    uint16 lookup = pHuffTable->mLookup[index];
+    uint8 length = (uint8)(lookup >> 8);
+    uint8 s = (uint8)(lookup & 0xF);
+    int16 fast = 0;
+
+    if (lookup && s && (length + s <= PJPG_HUFF_LOOKUP_BITS)) {
+      uint8 shift = (uint8)(PJPG_HUFF_LOOKUP_BITS - length - s);
+      int16 ac = huffExtend((index >> shift) & ((1 << s) - 1), s);
+
+      if ((ac >= -128) && (ac <= 127))
+        fast = (int16)(uint16)(((uint16)(uint8)ac << 8) |
+                               (lookup & 0xF0) | (length + s));
+    }
+
+    pFastAC[index] = fast;
+  }
+}
+//------------------------------------------------------------------------------
+// Decodes an AC coefficient with its extra bits, if possible.
+static PJPG_INLINE int16 fastAC(const int16 *pFastAC) {
+  int16 fast;
+
+  if (gBitCnt < 17)
+    fillBits();
+
+  fast = pFastAC[gBitAcc >> (32 - PJPG_HUFF_LOOKUP_BITS)];
+  if (fast) {
+    uint8 length = (uint8)(fast & 0xF);
+
+    gBitAcc <<= length;
+    gBitCnt = (uint8)(gBitCnt - length);
+  }
+
+  return fast;
 }
 //------------------------------------------------------------------------------
 static HuffTable *getHuffTable(uint8 index) {
@@ -542,7 +731,11 @@ static uint8 readDHTMarker(void) {
 
     left = (uint16)(left - totalRead);
 
-    huffCreate(bits, pHuffTable);
+    huffCreate(bits, pHuffVal, count, pHuffTable);
+    if (tableIndex == 2)
+      fastACCreate(pHuffTable, gFastAC2);
+    else if (tableIndex == 3)
+      fastACCreate(pHuffTable, gFastAC3);
   }
 
   return 0;
@@ -927,9 +1120,7 @@ static void fixInBuffer(void) {
 
   stuffChar((uint8)(gBitBuf >> 8));
 
-  gBitsLeft = 8;
-  getBits2(8);
-  getBits2(8);
+  startBits();
 }
 //------------------------------------------------------------------------------
 // Restart interval processing.
@@ -968,9 +1159,7 @@ static uint8 processRestart(void) {
 
   // Get the bit buffer going again
 
-  gBitsLeft = 8;
-  getBits2(8);
-  getBits2(8);
+  startBits();
 
   return 0;
 }
@@ -1222,11 +1411,17 @@ static PJPG_INLINE uint8 clamp(int16 s) {
   return (uint8)s;
 }
 
-static void idctRows(void) {
+// Rows not set in the rows mask are all zero and stay so.
+static void idctRows(uint8 rows) {
   uint8 i;
   int16 *pSrc = gCoeffBuf;
 
   for (i = 0; i < 8; i++) {
+    if (!(rows & (1 << i))) {
+      pSrc += 8;
+      continue;
+    }
+
     if ((pSrc[1] | pSrc[2] | pSrc[3] | pSrc[4] | pSrc[5] | pSrc[6] | pSrc[7]) ==
         0) {
       // Short circuit the 1D IDCT if only the DC component is non-zero
@@ -1654,9 +1849,19 @@ static void convertCr(uint8 dstOfs) {
   }
 }
 /*----------------------------------------------------------------------------*/
-static void transformBlock(uint8 mcuBlock) {
-  idctRows();
-  idctCols();
+// The rows mask tells the rows with AC coefficients. If there are none, all
+// pixels of the block have the value of the DC short circuits of the IDCT.
+static void transformBlock(uint8 mcuBlock, uint8 rows) {
+  if (rows) {
+    idctRows(rows | 1);
+    idctCols();
+  } else {
+    uint8 c = clamp(PJPG_DESCALE(gCoeffBuf[0]) + 128);
+    uint8 i;
+
+    for (i = 0; i < 64; i++)
+      gCoeffBuf[i] = c;
+  }
 
   switch (gScanType) {
   case PJPG_GRAYSCALE: {
@@ -1955,9 +2160,279 @@ static void transformBlockReduce(uint8 mcuBlock) {
   }
 }
 //------------------------------------------------------------------------------
-static uint8 decodeNextMCU(void) {
+// Scaled IDCTs: the 4x4 or 2x2 lowest frequencies of a block are transformed
+// into the pixels at the centers of 2x2 or 4x4 pixel squares. The coefficients
+// are prescaled for the Winograd IDCT, so the constants are
+// cos((2x+1)*u*pi/(2*n))/cos(u*pi/16) with 8 fractional bits.
+static PJPG_INLINE int16 imul_scaled(int16 w, int16 c) {
+  long x = (w * (long)c);
+  x += 128L;
+  return (int16)(PJPG_ARITH_SHIFT_RIGHT_8_L(x));
+}
+
+static void idctScaled4(void) {
+  uint8 i;
+  int16 *pSrc = gCoeffBuf;
+
+  for (i = 0; i < 4; i++) {
+    int16 x2 = imul_scaled(pSrc[2], 196);
+    int16 e0 = pSrc[0] + x2;
+    int16 e1 = pSrc[0] - x2;
+    int16 o0 = imul_scaled(pSrc[1], 241) + imul_scaled(pSrc[3], 118);
+    int16 o1 = imul_scaled(pSrc[1], 100) - imul_scaled(pSrc[3], 284);
+
+    pSrc[0] = e0 + o0;
+    pSrc[1] = e1 + o1;
+    pSrc[2] = e1 - o1;
+    pSrc[3] = e0 - o0;
+
+    pSrc += 8;
+  }
+
+  pSrc = gCoeffBuf;
+  for (i = 0; i < 4; i++) {
+    int16 x2 = imul_scaled(pSrc[2 * 8], 196);
+    int16 e0 = pSrc[0 * 8] + x2;
+    int16 e1 = pSrc[0 * 8] - x2;
+    int16 o0 = imul_scaled(pSrc[1 * 8], 241) + imul_scaled(pSrc[3 * 8], 118);
+    int16 o1 = imul_scaled(pSrc[1 * 8], 100) - imul_scaled(pSrc[3 * 8], 284);
+
+    pSrc[0 * 8] = clamp(PJPG_DESCALE(e0 + o0) + 128);
+    pSrc[1 * 8] = clamp(PJPG_DESCALE(e1 + o1) + 128);
+    pSrc[2 * 8] = clamp(PJPG_DESCALE(e1 - o1) + 128);
+    pSrc[3 * 8] = clamp(PJPG_DESCALE(e0 - o0) + 128);
+
+    pSrc++;
+  }
+}
+
+static void idctScaled2(void) {
+  int16 x01 = imul_scaled(gCoeffBuf[1], 185);
+  int16 x91 = imul_scaled(gCoeffBuf[9], 185);
+  int16 r0 = gCoeffBuf[0] + x01;
+  int16 r1 = gCoeffBuf[0] - x01;
+  int16 r8 = gCoeffBuf[8] + x91;
+  int16 r9 = gCoeffBuf[8] - x91;
+
+  r8 = imul_scaled(r8, 185);
+  r9 = imul_scaled(r9, 185);
+
+  gCoeffBuf[0] = clamp(PJPG_DESCALE(r0 + r8) + 128);
+  gCoeffBuf[1] = clamp(PJPG_DESCALE(r1 + r9) + 128);
+  gCoeffBuf[8] = clamp(PJPG_DESCALE(r0 - r8) + 128);
+  gCoeffBuf[9] = clamp(PJPG_DESCALE(r1 - r9) + 128);
+}
+/*----------------------------------------------------------------------------*/
+// Convert the Y of a reduced block to RGB
+static void copyYScaled(uint8 dstOfs) {
+  uint8 x, y;
+  uint8 n = gReduceSize;
+  uint8 *pRDst = gMCUBufR + dstOfs;
+  uint8 *pGDst = gMCUBufG + dstOfs;
+  uint8 *pBDst = gMCUBufB + dstOfs;
+  int16 *pSrc = gCoeffBuf;
+
+  for (y = 0; y < n; y++) {
+    for (x = 0; x < n; x++) {
+      uint8 c = (uint8)pSrc[x];
+
+      pRDst[x] = c;
+      pGDst[x] = c;
+      pBDst[x] = c;
+    }
+
+    pSrc += 8;
+    pRDst += 8;
+    pGDst += 8;
+    pBDst += 8;
+  }
+}
+/*----------------------------------------------------------------------------*/
+// Cb upsample and accumulate into a reduced block. The source pixel of the
+// destination pixel x, y is x >> sx, y >> sy.
+static void upsampleCbScaled(uint8 srcOfs, uint8 dstOfs, uint8 sx, uint8 sy) {
+  // Cb - affects G and B
+  uint8 x, y;
+  uint8 n = gReduceSize;
+  uint8 *pDstG = gMCUBufG + dstOfs;
+  uint8 *pDstB = gMCUBufB + dstOfs;
+
+  for (y = 0; y < n; y++) {
+    int16 *pSrc = gCoeffBuf + srcOfs + (y >> sy) * 8;
+
+    for (x = 0; x < n; x++) {
+      uint8 cb = (uint8)pSrc[x >> sx];
+      int16 cbG, cbB;
+
+      cbG = ((cb * 88U) >> 8U) - 44U;
+      pDstG[x] = subAndClamp(pDstG[x], cbG);
+
+      cbB = (cb + ((cb * 198U) >> 8U)) - 227U;
+      pDstB[x] = addAndClamp(pDstB[x], cbB);
+    }
+
+    pDstG += 8;
+    pDstB += 8;
+  }
+}
+/*----------------------------------------------------------------------------*/
+// Cr upsample and accumulate into a reduced block. The source pixel of the
+// destination pixel x, y is x >> sx, y >> sy.
+static void upsampleCrScaled(uint8 srcOfs, uint8 dstOfs, uint8 sx, uint8 sy) {
+  // Cr - affects R and G
+  uint8 x, y;
+  uint8 n = gReduceSize;
+  uint8 *pDstR = gMCUBufR + dstOfs;
+  uint8 *pDstG = gMCUBufG + dstOfs;
+
+  for (y = 0; y < n; y++) {
+    int16 *pSrc = gCoeffBuf + srcOfs + (y >> sy) * 8;
+
+    for (x = 0; x < n; x++) {
+      uint8 cr = (uint8)pSrc[x >> sx];
+      int16 crR, crG;
+
+      crR = (cr + ((cr * 103U) >> 8U)) - 179;
+      pDstR[x] = addAndClamp(pDstR[x], crR);
+
+      crG = ((cr * 183U) >> 8U) - 91;
+      pDstG[x] = subAndClamp(pDstG[x], crG);
+    }
+
+    pDstR += 8;
+    pDstG += 8;
+  }
+}
+//------------------------------------------------------------------------------
+static void transformBlockScaled(uint8 mcuBlock) {
+  uint8 h = gReduceSize >> 1;
+
+  if (gReduce == PJPG_REDUCE_2)
+    idctScaled4();
+  else
+    idctScaled2();
+
+  switch (gScanType) {
+  case PJPG_GRAYSCALE: {
+    // MCU size: 1, 1 block per MCU
+    copyYScaled(0);
+    break;
+  }
+  case PJPG_YH1V1: {
+    // MCU size: 8x8, 3 blocks per MCU
+    switch (mcuBlock) {
+    case 0: {
+      copyYScaled(0);
+      break;
+    }
+    case 1: {
+      upsampleCbScaled(0, 0, 0, 0);
+      break;
+    }
+    case 2: {
+      upsampleCrScaled(0, 0, 0, 0);
+      break;
+    }
+    }
+
+    break;
+  }
+  case PJPG_YH1V2: {
+    // MCU size: 8x16, 4 blocks per MCU
+    switch (mcuBlock) {
+    case 0: {
+      copyYScaled(0);
+      break;
+    }
+    case 1: {
+      copyYScaled(128);
+      break;
+    }
+    case 2: {
+      upsampleCbScaled(0, 0, 0, 1);
+      upsampleCbScaled(h * 8, 128, 0, 1);
+      break;
+    }
+    case 3: {
+      upsampleCrScaled(0, 0, 0, 1);
+      upsampleCrScaled(h * 8, 128, 0, 1);
+      break;
+    }
+    }
+
+    break;
+  }
+  case PJPG_YH2V1: {
+    // MCU size: 16x8, 4 blocks per MCU
+    switch (mcuBlock) {
+    case 0: {
+      copyYScaled(0);
+      break;
+    }
+    case 1: {
+      copyYScaled(64);
+      break;
+    }
+    case 2: {
+      upsampleCbScaled(0, 0, 1, 0);
+      upsampleCbScaled(h, 64, 1, 0);
+      break;
+    }
+    case 3: {
+      upsampleCrScaled(0, 0, 1, 0);
+      upsampleCrScaled(h, 64, 1, 0);
+      break;
+    }
+    }
+
+    break;
+  }
+  case PJPG_YH2V2: {
+    // MCU size: 16x16, 6 blocks per MCU
+    switch (mcuBlock) {
+    case 0: {
+      copyYScaled(0);
+      break;
+    }
+    case 1: {
+      copyYScaled(64);
+      break;
+    }
+    case 2: {
+      copyYScaled(128);
+      break;
+    }
+    case 3: {
+      copyYScaled(192);
+      break;
+    }
+    case 4: {
+      upsampleCbScaled(0, 0, 1, 1);
+      upsampleCbScaled(h, 64, 1, 1);
+      upsampleCbScaled(h * 8, 128, 1, 1);
+      upsampleCbScaled(h + h * 8, 192, 1, 1);
+      break;
+    }
+    case 5: {
+      upsampleCrScaled(0, 0, 1, 1);
+      upsampleCrScaled(h, 64, 1, 1);
+      upsampleCrScaled(h * 8, 128, 1, 1);
+      upsampleCrScaled(h + h * 8, 192, 1, 1);
+      break;
+    }
+    }
+
+    break;
+  }
+  }
+}
+//------------------------------------------------------------------------------
+// Decodes the next MCU. If skip is set, the MCU is only entropy decoded to keep
+// track of the DC values, without dequantization, IDCT and color conversion.
+static uint8 decodeNextMCU(uint8 skip) {
   uint8 status;
   uint8 mcuBlock;
+  uint8 mask = skip ? 0x3F : gReduceMask;
 
   if (gRestartInterval) {
     if (gRestartsLeft == 0) {
@@ -1992,15 +2467,35 @@ static uint8 decodeNextMCU(void) {
 
     compACTab = gCompACTab[componentID];
 
-    if (gReduce) {
-      // Decode, but throw out the AC coefficients in reduce mode.
+    if (gReduce || skip) {
+      // Decode, but throw out the AC coefficients in reduce mode, except the
+      // lowest frequencies needed by the scaled IDCTs.
+      for (k = 1; k < 3 * 8 + 4; k++)
+        if (!(k & mask))
+          gCoeffBuf[k] = 0;
+
       for (k = 1; k < 64; k++) {
+        uint16 extraBits;
+        int16 fast = fastAC(compACTab ? gFastAC3 : gFastAC2);
+
+        if (fast) {
+          r = (fast >> 4) & 0xF;
+          if ((k + r) > 63)
+            return PJPG_DECODE_ERROR;
+
+          k = (uint8)(k + r);
+          if (!(ZAG[k] & mask))
+            gCoeffBuf[ZAG[k]] = (int8)((uint16)fast >> 8) * pQ[k];
+          continue;
+        }
+
         s = huffDecode(compACTab ? &gHuffTab3 : &gHuffTab2,
                        compACTab ? gHuffVal3 : gHuffVal2);
 
+        extraBits = 0;
         numExtraBits = s & 0xF;
         if (numExtraBits)
-          getBits2(numExtraBits);
+          extraBits = getBits2(numExtraBits);
 
         r = s >> 4;
         s &= 15;
@@ -2012,6 +2507,9 @@ static uint8 decodeNextMCU(void) {
 
             k = (uint8)(k + r);
           }
+
+          if (!(ZAG[k] & mask))
+            gCoeffBuf[ZAG[k]] = huffExtend(extraBits, s) * pQ[k];
         } else {
           if (r == 15) {
             if ((k + 16) > 64)
@@ -2023,11 +2521,34 @@ static uint8 decodeNextMCU(void) {
         }
       }
 
-      transformBlockReduce(mcuBlock);
+      if (skip)
+        continue;
+
+      if (gReduce == PJPG_REDUCE_8)
+        transformBlockReduce(mcuBlock);
+      else
+        transformBlockScaled(mcuBlock);
     } else {
-      // Decode and dequantize AC coefficients
+      // Decode and dequantize AC coefficients, only the non-zero ones are
+      // written and their rows noted.
+      uint8 rows = 0;
+
+      memset(gCoeffBuf + 1, 0, sizeof(gCoeffBuf) - sizeof(gCoeffBuf[0]));
+
       for (k = 1; k < 64; k++) {
         uint16 extraBits;
+        int16 fast = fastAC(compACTab ? gFastAC3 : gFastAC2);
+
+        if (fast) {
+          r = (fast >> 4) & 0xF;
+          if ((k + r) > 63)
+            return PJPG_DECODE_ERROR;
+
+          k = (uint8)(k + r);
+          gCoeffBuf[ZAG[k]] = (int8)((uint16)fast >> 8) * pQ[k];
+          rows |= 1 << (ZAG[k] >> 3);
+          continue;
+        }
 
         s = huffDecode(compACTab ? &gHuffTab3 : &gHuffTab2,
                        compACTab ? gHuffVal3 : gHuffVal2);
@@ -2041,46 +2562,34 @@ static uint8 decodeNextMCU(void) {
         s &= 15;
 
         if (s) {
-          int16 ac;
-
           if (r) {
             if ((k + r) > 63)
               return PJPG_DECODE_ERROR;
 
-            while (r) {
-              gCoeffBuf[ZAG[k++]] = 0;
-              r--;
-            }
+            k = (uint8)(k + r);
           }
 
-          ac = huffExtend(extraBits, s);
-
-          gCoeffBuf[ZAG[k]] = ac * pQ[k];
+          gCoeffBuf[ZAG[k]] = huffExtend(extraBits, s) * pQ[k];
+          rows |= 1 << (ZAG[k] >> 3);
         } else {
           if (r == 15) {
             if ((k + 16) > 64)
               return PJPG_DECODE_ERROR;
 
-            for (r = 16; r > 0; r--)
-              gCoeffBuf[ZAG[k++]] = 0;
-
-            k--; // - 1 because the loop counter is k
+            k += (16 - 1); // - 1 because the loop counter is k
           } else
             break;
         }
       }
 
-      while (k < 64)
-        gCoeffBuf[ZAG[k++]] = 0;
-
-      transformBlock(mcuBlock);
+      transformBlock(mcuBlock, rows);
     }
   }
 
   return 0;
 }
 //------------------------------------------------------------------------------
-unsigned char pjpeg_decode_mcu(void) {
+static uint8 decodeMCU(uint8 skip) {
   uint8 status;
 
   if (gCallbackStatus)
@@ -2089,7 +2598,7 @@ unsigned char pjpeg_decode_mcu(void) {
   if (!gNumMCUSRemaining)
     return PJPG_NO_MORE_BLOCKS;
 
-  status = decodeNextMCU();
+  status = decodeNextMCU(skip);
   if ((status) || (gCallbackStatus))
     return gCallbackStatus ? gCallbackStatus : status;
 
@@ -2098,10 +2607,102 @@ unsigned char pjpeg_decode_mcu(void) {
   return 0;
 }
 //------------------------------------------------------------------------------
-unsigned char
-pjpeg_decode_init(pjpeg_image_info_t *pInfo,
-                  pjpeg_need_bytes_callback_t pNeed_bytes_callback,
-                  void *pCallback_data, unsigned char reduce) {
+unsigned char pjpeg_decode_mcu(void) { return decodeMCU(0); }
+//------------------------------------------------------------------------------
+unsigned char pjpeg_skip_mcu(void) { return decodeMCU(1); }
+//------------------------------------------------------------------------------
+// Continues with the entropy coded data of the given restart interval.
+static uint8 startInterval(uint16 interval, const uint8 *pData,
+                           unsigned long size) {
+  uint16 numMCUs = gMaxMCUSPerRow * gMaxMCUSPerCol;
+  unsigned long first = (unsigned long)interval * gRestartInterval;
+
+  if (first >= numMCUs)
+    return PJPG_NO_MORE_BLOCKS;
+
+  gInMemory = 1;
+  gInPtr = pData;
+  gInEnd = pData + size;
+  gTemFlag = 0;
+
+  gLastDC[0] = 0;
+  gLastDC[1] = 0;
+  gLastDC[2] = 0;
+
+  gRestartsLeft = gRestartInterval;
+  gNextRestartNum = interval & 7;
+  gNumMCUSRemaining = numMCUs - first;
+
+  startBits();
+
+  return 0;
+}
+//------------------------------------------------------------------------------
+unsigned char pjpeg_decode_restart(unsigned short interval,
+                                   const unsigned char *pData,
+                                   unsigned long size) {
+  if (!gRestartInterval)
+    return PJPG_UNSUPPORTED_MODE;
+
+  return startInterval(interval, pData, size);
+}
+//------------------------------------------------------------------------------
+static void getInfo(pjpeg_image_info_t *pInfo) {
+  pInfo->m_width = gImageXSize;
+  pInfo->m_height = gImageYSize;
+  pInfo->m_comps = gCompsInFrame;
+  pInfo->m_scanType = gScanType;
+  pInfo->m_MCUSPerRow = gMaxMCUSPerRow;
+  pInfo->m_MCUSPerCol = gMaxMCUSPerCol;
+  pInfo->m_MCUWidth = gMaxMCUXSize;
+  pInfo->m_MCUHeight = gMaxMCUYSize;
+  pInfo->m_pMCUBufR = gMCUBufR;
+  pInfo->m_pMCUBufG = gMCUBufG;
+  pInfo->m_pMCUBufB = gMCUBufB;
+}
+//------------------------------------------------------------------------------
+static void setReduce(uint8 reduce) {
+  switch (reduce) {
+  case PJPG_REDUCE_NONE:
+    gReduceSize = 8;
+    gReduceMask = 0;
+    break;
+  case PJPG_REDUCE_2:
+    gReduceSize = 4;
+    gReduceMask = 0x24; // x or y >= 4
+    break;
+  case PJPG_REDUCE_4:
+    gReduceSize = 2;
+    gReduceMask = 0x36; // x or y >= 2
+    break;
+  default:
+    reduce = PJPG_REDUCE_8;
+    gReduceSize = 1;
+    gReduceMask = 0x3F; // all AC coefficients
+    break;
+  }
+
+  gReduce = reduce;
+}
+//------------------------------------------------------------------------------
+unsigned char pjpeg_decode_rescan(pjpeg_image_info_t *pInfo,
+                                  const unsigned char *pData,
+                                  unsigned long size, unsigned char reduce) {
+  if (!gHeaderValid)
+    return PJPG_NOT_JPEG;
+
+  gCallbackStatus = 0;
+  setReduce(reduce);
+
+  uint8 status = startInterval(0, pData, size);
+  if (status)
+    return status;
+
+  getInfo(pInfo);
+  return 0;
+}
+//------------------------------------------------------------------------------
+static uint8 decodeInit(pjpeg_image_info_t *pInfo, unsigned char reduce) {
   uint8 status;
 
   pInfo->m_width = 0;
@@ -2116,10 +2717,9 @@ pjpeg_decode_init(pjpeg_image_info_t *pInfo,
   pInfo->m_pMCUBufG = (unsigned char *)0;
   pInfo->m_pMCUBufB = (unsigned char *)0;
 
-  g_pNeedBytesCallback = pNeed_bytes_callback;
-  g_pCallback_data = pCallback_data;
   gCallbackStatus = 0;
-  gReduce = reduce;
+  setReduce(reduce);
+  gHeaderValid = 0;
 
   status = init();
   if ((status) || (gCallbackStatus))
@@ -2137,17 +2737,30 @@ pjpeg_decode_init(pjpeg_image_info_t *pInfo,
   if ((status) || (gCallbackStatus))
     return gCallbackStatus ? gCallbackStatus : status;
 
-  pInfo->m_width = gImageXSize;
-  pInfo->m_height = gImageYSize;
-  pInfo->m_comps = gCompsInFrame;
-  pInfo->m_scanType = gScanType;
-  pInfo->m_MCUSPerRow = gMaxMCUSPerRow;
-  pInfo->m_MCUSPerCol = gMaxMCUSPerCol;
-  pInfo->m_MCUWidth = gMaxMCUXSize;
-  pInfo->m_MCUHeight = gMaxMCUYSize;
-  pInfo->m_pMCUBufR = gMCUBufR;
-  pInfo->m_pMCUBufG = gMCUBufG;
-  pInfo->m_pMCUBufB = gMCUBufB;
+  getInfo(pInfo);
+  gHeaderValid = 1;
 
   return 0;
 }
+//------------------------------------------------------------------------------
+unsigned char
+pjpeg_decode_init(pjpeg_image_info_t *pInfo,
+                  pjpeg_need_bytes_callback_t pNeed_bytes_callback,
+                  void *pCallback_data, unsigned char reduce) {
+  g_pNeedBytesCallback = pNeed_bytes_callback;
+  g_pCallback_data = pCallback_data;
+  gInMemory = 0;
+
+  return decodeInit(pInfo, reduce);
+}
+//------------------------------------------------------------------------------
+unsigned char pjpeg_decode_init_memory(pjpeg_image_info_t *pInfo,
+                                       const unsigned char *pData,
+                                       unsigned long size,
+                                       unsigned char reduce) {
+  gInMemory = 1;
+  gInPtr = pData;
+  gInEnd = pData + size;
+
+  return decodeInit(pInfo, reduce);
+}
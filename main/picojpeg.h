@@ -53,6 +53,15 @@ enum {
   PJPG_UNSUPPORTED_MODE, // picojpeg doesn't support progressive JPEG's
 };
 
+// Values of the reduce parameter. The reduced pixels of each 8x8 block are in
+// its top left corner, with rows 8 bytes apart as usual.
+enum {
+  PJPG_REDUCE_NONE = 0, // 8x8 pixels per block
+  PJPG_REDUCE_8 = 1,    // 1x1 pixel per block, the DC value
+  PJPG_REDUCE_2 = 2,    // 4x4 pixels per block
+  PJPG_REDUCE_4 = 3,    // 2x2 pixels per block
+};
+
 // Scan types
 typedef enum {
   PJPG_GRAYSCALE,
@@ -124,21 +133,51 @@ typedef unsigned char (*pjpeg_need_bytes_callback_t)(
 
 // Initializes the decompressor. Returns 0 on success, or one of the above error
 // codes on failure. pNeed_bytes_callback will be called to fill the
-// decompressor's internal input buffer. If reduce is 1, only the first pixel of
-// each block will be decoded. This mode is much faster because it skips the AC
-// dequantization, IDCT and chroma upsampling of every image pixel. Not thread
-// safe.
+// decompressor's internal input buffer. If reduce is PJPG_REDUCE_8, only the
+// first pixel of each block will be decoded. This mode is much faster because
+// it skips the AC dequantization, IDCT and chroma upsampling of every image
+// pixel. PJPG_REDUCE_2 and PJPG_REDUCE_4 decode half and a quarter of the width
+// and height, with IDCTs of only the lowest frequencies. Not thread safe.
 unsigned char
 pjpeg_decode_init(pjpeg_image_info_t *pInfo,
                   pjpeg_need_bytes_callback_t pNeed_bytes_callback,
                   void *pCallback_data, unsigned char reduce);
 
+// Same as pjpeg_decode_init(), but for a file that is completely in memory.
+// The data is read directly, without calling back and copying. It must stay
+// unchanged until the image is decompressed. Not thread safe.
+unsigned char pjpeg_decode_init_memory(pjpeg_image_info_t *pInfo,
+                                       const unsigned char *pData,
+                                       unsigned long size,
+                                       unsigned char reduce);
+
 // Decompresses the file's next MCU. Returns 0 on success, PJPG_NO_MORE_BLOCKS
 // if no more blocks are available, or an error code. Must be called a total of
 // m_MCUSPerRow*m_MCUSPerCol times to completely decompress the image. Not
 // thread safe.
 unsigned char pjpeg_decode_mcu(void);
 
+// Same as pjpeg_decode_mcu(), but the MCU is only entropy decoded to keep
+// track of the DC values. The MCU buffers are not changed. Much faster for MCUs
+// whose pixels are not needed. Not thread safe.
+unsigned char pjpeg_skip_mcu(void);
+
+// Continues decoding at the first MCU of the given restart interval, skipping
+// the MCUs before. pData points to the data of this interval in memory,
+// without a leading restart marker. Returns PJPG_UNSUPPORTED_MODE if the image
+// has no restart intervals. Not thread safe.
+unsigned char pjpeg_decode_restart(unsigned short interval,
+                                   const unsigned char *pData,
+                                   unsigned long size);
+
+// Starts decoding an image with the same headers as the one initialized last.
+// The headers are not parsed again and the Huffman and quantization tables are
+// kept, but the image may be reduced differently. pData points to the data
+// following the SOS marker segment in memory. Not thread safe.
+unsigned char pjpeg_decode_rescan(pjpeg_image_info_t *pInfo,
+                                  const unsigned char *pData,
+                                  unsigned long size, unsigned char reduce);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,341 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * rmtled.c
+ *
+ *  Created on: 21.10.2018
+ *      Author: hoene
+ */
+
+#include "rmtled.h"
+
+#include "driver/rmt.h"
+#include "esp_log.h"
+#include "fastrmt.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/gpio_struct.h"
+#include "soc/rmt_reg.h"
+
+static const char *TAG = "#rmtled";
+
+#define RMT_MEM_BLOCK_BYTE_NUM (4 * RMT_MEM_ITEM_NUM)
+#define RMT_MEM_BLOCKS (8)
+
+/** Frequency of the quartz */
+#define FREQ_INPUT (8e7)
+
+/**
+ * RMT items of all nibbles per line, most significant bit first. The ISR and
+ * rmtled_start expand each byte with two lookups instead of testing every bit.
+ * Each line has its own table, thus lines may run chips of different timing.
+ */
+IRAM_ATTR uint32_t rmtled_nibble_items[FASTRMT_MAXIMAL_LINES][16][4];
+
+/**
+ * fastrmt structure
+ */
+
+extern struct FASTRMI_DATA {
+  uint32_t counter;
+  uint32_t length;
+  uint32_t baseAddress;
+  uint32_t mask;
+  uint32_t intmask;
+  uint8_t *input;
+  const uint32_t *items; /* nibble items of the line */
+  uint32_t status;       /* address of the RMT status register */
+} fastrmi_para[FASTRMT_MAXIMAL_LINES];
+
+extern int32_t _l5_counter, _l5_flags;
+
+static intr_handle_t isr_handle;
+static uint8_t num_lines;
+static const uint8_t *gpios;
+
+static struct {
+  rmt_channel_t rmtChannel;
+  uint8_t memBlocks;
+} lines[FASTRMT_MAXIMAL_LINES];
+
+/**
+ * RMT structure for one (high) and zero (low) impulse
+ */
+static void rmtled_set_pulses(uint8_t line, uint32_t frequency, uint8_t one,
+                              uint8_t zero) {
+  rmt_item32_t high = {.level0 = 1, .level1 = 0};
+  rmt_item32_t low = {.level0 = 1, .level1 = 0};
+
+  if (line >= FASTRMT_MAXIMAL_LINES)
+    return;
+
+  double factor = FREQ_INPUT / (frequency * 100.);
+  high.duration0 = factor * one;
+  high.duration1 = factor * (100 - one);
+  low.duration0 = factor * zero;
+  low.duration1 = factor * (100 - zero);
+
+  for (int n = 0; n < 16; n++)
+    for (int b = 0; b < 4; b++)
+      rmtled_nibble_items[line][n][b] = n & (8 >> b) ? high.val : low.val;
+  fastrmi_para[line].items = &rmtled_nibble_items[line][0][0];
+}
+
+/**
+ * level 5 interrupts to send a line: one per half of its RMT memory
+ */
+static uint32_t rmtled_interrupts(uint32_t numBytes, uint8_t blocks) {
+  uint32_t items = blocks * RMT_MEM_ITEM_NUM / 2;
+  return (numBytes * 8 + items - 1) / items;
+}
+
+/**
+ * assign the RMT memory blocks to the lines. Lines without data get no channel
+ * at all. Starting with one block each, the line causing the most interrupts
+ * gets its memory doubled as long as blocks are left. The ISR requires that
+ * the memory of a line is a power of two of blocks and aligned to its size,
+ * thus the lines are placed in the order of decreasing memory.
+ */
+static void rmtled_allocBlocks(const uint32_t *size) {
+  uint8_t order[FASTRMT_MAXIMAL_LINES];
+  uint8_t n = 0, used = 0;
+
+  for (uint8_t i = 0; i < num_lines; i++) {
+    lines[i].memBlocks = 0;
+    if (size[i] > 0 && used < RMT_MEM_BLOCKS) {
+      lines[i].memBlocks = 1;
+      order[n++] = i;
+      used++;
+    }
+  }
+
+  for (;;) {
+    int best = -1;
+    uint32_t most = 1;
+    for (uint8_t k = 0; k < n; k++) {
+      uint8_t l = order[k];
+      uint32_t count = rmtled_interrupts(size[l], lines[l].memBlocks);
+      if (used + lines[l].memBlocks <= RMT_MEM_BLOCKS && count > most) {
+        most = count;
+        best = l;
+      }
+    }
+    if (best < 0)
+      break;
+    used += lines[best].memBlocks;
+    lines[best].memBlocks *= 2;
+  }
+
+  /* largest first, so each channel starts at a multiple of its size */
+  for (uint8_t k = 1; k < n; k++) {
+    uint8_t l = order[k];
+    int j = k;
+    for (; j > 0 && lines[order[j - 1]].memBlocks < lines[l].memBlocks; j--)
+      order[j] = order[j - 1];
+    order[j] = l;
+  }
+
+  uint8_t channel = 0;
+  uint32_t total = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    uint8_t l = order[k];
+    uint32_t count = rmtled_interrupts(size[l], lines[l].memBlocks);
+    lines[l].rmtChannel = channel;
+    channel += lines[l].memBlocks;
+    total += count;
+    ESP_LOGI(TAG, "line %d channel %d blocks %d: %d interrupts per frame", l,
+             lines[l].rmtChannel, lines[l].memBlocks, count);
+  }
+  ESP_LOGI(TAG, "%d interrupts per frame", total);
+}
+
+/**
+ * stop all channels and switch pins, which are still driven by a channel, to
+ * low GPIO outputs. Other pins may belong to another driver meanwhile.
+ */
+static void rmtled_release() {
+  for (uint8_t i = 0; i < num_lines; i++) {
+    fastrmi_para[i].length = 0;
+    fastrmi_para[i].intmask = 0;
+    if (lines[i].memBlocks == 0)
+      continue;
+    rmt_tx_stop(lines[i].rmtChannel);
+    ESP_ERROR_CHECK(rmt_set_tx_thr_intr_en(lines[i].rmtChannel, false, 0));
+    if (GPIO.func_out_sel_cfg[gpios[i]].func_sel ==
+        RMT_SIG_OUT0_IDX + lines[i].rmtChannel) {
+      gpio_set_level(gpios[i], 0);
+      gpio_set_direction(gpios[i], GPIO_MODE_OUTPUT);
+    }
+    lines[i].memBlocks = 0;
+  }
+}
+
+static void rmtled_configure() {
+  for (uint8_t i = 0; i < num_lines; i++) {
+    if (lines[i].memBlocks == 0)
+      continue;
+
+    rmt_config_t config = {.rmt_mode = RMT_MODE_TX,
+                           .channel = lines[i].rmtChannel,
+                           .clk_div = 1, // 80 MHz (APB CLK typical)
+                           .gpio_num = gpios[i],
+                           .mem_block_num = lines[i].memBlocks,
+                           .tx_config = {
+                               .loop_en = false,
+                               .carrier_en = false,
+                               .carrier_freq_hz = 0,
+                               .carrier_duty_percent = 0,
+                               .carrier_level = RMT_CARRIER_LEVEL_HIGH,
+                               .idle_level = RMT_IDLE_LEVEL_LOW,
+                               .idle_output_en = true,
+                           }};
+
+    gpio_pad_select_gpio(gpios[i]);
+    gpio_set_level(gpios[i], 0);
+    gpio_set_direction(gpios[i], GPIO_MODE_OUTPUT);
+
+    ESP_ERROR_CHECK(rmt_config(&config));
+    ESP_ERROR_CHECK(
+        rmt_set_tx_thr_intr_en(lines[i].rmtChannel, true,
+                               lines[i].memBlocks * RMT_MEM_ITEM_NUM / 2));
+    ESP_LOGD(TAG, "init %d config %d blocks %d %p", i, gpios[i],
+             lines[i].memBlocks, &RMT.tx_lim_ch[lines[i].rmtChannel]);
+  }
+}
+
+/**
+ * distribute the RMT memory by the sizes of the lines in bytes
+ */
+static void rmtled_set_sizes(const uint32_t *size) {
+  rmtled_release();
+  rmtled_allocBlocks(size);
+  rmtled_configure();
+}
+
+static esp_err_t rmtled_init(const uint8_t *gpio, uint8_t n) {
+  if (n == 0 || n > FASTRMT_MAXIMAL_LINES)
+    return ESP_ERR_INVALID_ARG;
+  num_lines = n;
+  gpios = gpio;
+
+  /* equal shares until the sizes are known */
+  uint32_t size[FASTRMT_MAXIMAL_LINES];
+  for (uint8_t i = 0; i < n; i++)
+    size[i] = 1;
+  rmtled_allocBlocks(size);
+  rmtled_configure();
+
+  return esp_intr_alloc(ETS_RMT_INTR_SOURCE,
+                        ESP_INTR_FLAG_LEVEL5 | ESP_INTR_FLAG_IRAM, NULL, NULL,
+                        &isr_handle);
+}
+
+/**
+ * prefill the RMT memory of a line and start it, the ISR sends the rest
+ */
+static void rmtled_start(uint8_t i, uint8_t *src, uint32_t numBytes) {
+  uint8_t bytesPre = lines[i].memBlocks * RMT_MEM_ITEM_NUM / 8;
+
+  if (src == NULL || lines[i].memBlocks == 0)
+    return;
+
+  /** fill initial bytes int RMT buffer*/
+  rmt_item32_t *dst =
+      (void *)(0x3ff56800 + RMT_MEM_BLOCK_BYTE_NUM * lines[i].rmtChannel);
+
+  ESP_LOGD(TAG, "%d %d %d %08X %08X %08X %d %d %p %p %p", _l5_counter, i,
+           lines[i].rmtChannel, _l5_flags, fastrmi_para[i].baseAddress,
+           fastrmi_para[i].mask, fastrmi_para[i].counter,
+           fastrmi_para[i].length, src, dst, &RMT.conf_ch[i]);
+
+  fastrmi_para[i].input = src;
+
+  for (uint8_t j = 0; j < bytesPre; j++) {
+    if (j == numBytes) {
+      dst->val = 0;
+      break;
+    }
+    uint8_t s = *src++;
+    const uint32_t *high = rmtled_nibble_items[i][s >> 4];
+    const uint32_t *low = rmtled_nibble_items[i][s & 0x0f];
+
+    (dst++)->val = high[0];
+    (dst++)->val = high[1];
+    (dst++)->val = high[2];
+    (dst++)->val = high[3];
+    (dst++)->val = low[0];
+    (dst++)->val = low[1];
+    (dst++)->val = low[2];
+    (dst++)->val = low[3];
+  }
+
+  /** fill remaining bytes into fastrmi buffer */
+  fastrmi_para[i].counter = bytesPre;
+  fastrmi_para[i].length = numBytes;
+  fastrmi_para[i].baseAddress =
+      0x3ff56800 + RMT_MEM_BLOCK_BYTE_NUM * lines[i].rmtChannel;
+  fastrmi_para[i].mask = (lines[i].memBlocks * RMT_MEM_BLOCK_BYTE_NUM) - 1;
+  fastrmi_para[i].intmask = 0x1000000 << lines[i].rmtChannel;
+  fastrmi_para[i].status = RMT_CH0STATUS_REG + 4 * lines[i].rmtChannel;
+
+  /** start transmitting */
+  ESP_ERROR_CHECK(rmt_tx_start(lines[i].rmtChannel, true));
+}
+
+static void rmtled_send(uint8_t *const *input, const uint32_t *length) {
+  for (uint8_t i = 0; i < num_lines; i++)
+    rmtled_start(i, input[i], length[i]);
+}
+
+static esp_err_t rmtled_isFinished() {
+  for (uint8_t i = 0; i < num_lines; i++) {
+    if (fastrmi_para[i].length != 0 &&
+        fastrmi_para[i].counter < fastrmi_para[i].length)
+      return ESP_ERR_TIMEOUT;
+  }
+  return ESP_OK;
+}
+
+static void rmtled_stop() {
+  for (uint8_t i = 0; i < num_lines; i++)
+    fastrmi_para[i].length = 0;
+}
+
+static void rmtled_free() {
+  for (uint8_t i = 0; i < num_lines; i++) {
+    if (lines[i].memBlocks == 0)
+      continue;
+    rmt_tx_stop(lines[i].rmtChannel);
+    ESP_LOGD(TAG, "free %d %d", i, lines[i].rmtChannel);
+    ESP_ERROR_CHECK(rmt_set_tx_thr_intr_en(lines[i].rmtChannel, false, 0));
+    ESP_ERROR_CHECK(rmt_set_tx_intr_en(lines[i].rmtChannel, false));
+    fastrmi_para[i].length = 0;
+    fastrmi_para[i].intmask = 0;
+    lines[i].memBlocks = 0;
+  }
+  rmt_isr_deregister(isr_handle);
+}
+
+/**
+ * lines without a channel get their pin at the next rmtled_set_sizes
+ */
+static esp_err_t rmtled_attach(uint8_t line, uint8_t gpio) {
+  if (line >= num_lines)
+    return ESP_ERR_INVALID_ARG;
+  if (lines[line].memBlocks == 0)
+    return ESP_OK;
+  return rmt_set_pin(lines[line].rmtChannel, RMT_MODE_TX, gpio);
+}
+
+const struct OWNLED_DRIVER rmtled_driver = {
+    .name = "rmt",
+    .init = rmtled_init,
+    .set_pulses = rmtled_set_pulses,
+    .send = rmtled_send,
+    .isFinished = rmtled_isFinished,
+    .stop = rmtled_stop,
+    .free = rmtled_free,
+    .attach = rmtled_attach,
+    .set_sizes = rmtled_set_sizes,
+};
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * rmtled.h
+ *
+ *  Created on: 21.10.2018
+ *      Author: hoene
+ */
+
+#ifndef MAIN_RMTLED_H_
+#define MAIN_RMTLED_H_
+
+#include "ownled.h"
+
+/** RMT unit fed by the level 5 interrupt in fastrmt.S, up to 8 lines */
+extern const struct OWNLED_DRIVER rmtled_driver;
+
+#endif /* MAIN_RMTLED_H_ */
@@ -20,6 +20,7 @@
 #include "esp_log.h"
 #include "led.h"
 #include "mjpeg.h"
+#include "ownled.h"
 #include "status.h"
 
 static const char *TAG = "#rtp";
@@ -111,17 +112,26 @@ static int artnet_parse(uint8_t *buffer, uint16_t length) {
   }
   artnet_sequence[universe] = sequence;
 
+  /* RGBW LEDs take four channels per pixel, thus 128 pixels per universe */
+  bool white = ownled_hasWhite();
+  int channels = white ? 4 : 3;
   uint16_t width = config_get_artnet_width();
-  uint16_t x = universe * 170;
+  uint16_t x = universe * (512 / channels);
   uint16_t y = x / width;
   x = x % width;
-  for (int i = 0; i < dmxlen - 2; i += 3) {
-    led_rgb_rtp(x, y, buffer[19 + i], buffer[18 + i], buffer[20 + i]);
-    x++;
-    if (x == width) {
-      y++;
-      x = 0;
-    }
+  for (int i = 0; i <= dmxlen - channels;) {
+    int n = (dmxlen - i) / channels;
+    if (n > width - x)
+      n = width - x;
+    if (white)
+      led_write_row_rgbw(x, y, n, buffer + 19 + i, buffer + 18 + i,
+                         buffer + 20 + i, buffer + 21 + i, 4);
+    else
+      led_write_row(x, y, n, buffer + 19 + i, buffer + 18 + i,
+                    buffer + 20 + i, 3);
+    i += n * channels;
+    y++;
+    x = 0;
   }
 
   status_artnet_good();
@@ -179,6 +189,7 @@ int rtp_parse(uint8_t *buffer, int length) {
     return -5;
   }
 
+  /* a new frame starts with a new timestamp, even if packets got lost */
   int8_t restart = 1;
   if (counter != 0) {
     uint16_t diff = header->seq - last_seq;
@@ -186,10 +197,9 @@ int rtp_parse(uint8_t *buffer, int length) {
       ESP_LOGE(TAG, "strange sequence %d %d", header->seq, last_seq);
       if (diff < 5)
         status_rtp_loss(diff - 1);
-    } else {
-      if (header->ts == last_ts)
-        restart = 0; // all ok
     }
+    if (header->ts == last_ts)
+      restart = 0;
   }
 
   last_seq = header->seq;
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * simled.c
+ *
+ * LED lines simulated without hardware
+ */
+
+#include "simled.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "#simled";
+
+/** low time to latch the data, in us */
+#define SIMLED_LATCH_TIME (280)
+
+static uint8_t num_lines;
+static struct {
+  uint32_t frequency;
+  uint8_t *bytes;
+  uint32_t size;
+  uint32_t length;
+} lines[OWNLED_MAXIMAL_LINES];
+
+static uint32_t frames;
+static int64_t start, duration;
+
+/**
+ * time in us to send a line of the given length, for example 30 us per RGB LED
+ * at 800 kHz
+ */
+int64_t simled_transmit_time(uint32_t bytes, uint32_t frequency) {
+  return bytes * 8 * 1000000LL / frequency + SIMLED_LATCH_TIME;
+}
+
+static esp_err_t simled_init(const uint8_t *gpio, uint8_t n) {
+  if (n > OWNLED_MAXIMAL_LINES)
+    return ESP_ERR_INVALID_ARG;
+  num_lines = n;
+  frames = 0;
+  start = duration = 0;
+  return ESP_OK;
+}
+
+static void simled_set_pulses(uint8_t line, uint32_t f, uint8_t one,
+                              uint8_t zero) {
+  if (line < OWNLED_MAXIMAL_LINES)
+    lines[line].frequency = f;
+}
+
+static void simled_send(uint8_t *const *input, const uint32_t *length) {
+  uint32_t longest = 0;
+
+  duration = 0;
+  for (uint8_t i = 0; i < num_lines; i++) {
+    uint32_t n = input[i] ? length[i] : 0;
+    if (n > lines[i].size) {
+      free(lines[i].bytes);
+      lines[i].bytes = malloc(n);
+      lines[i].size = lines[i].bytes ? n : 0;
+      if (lines[i].bytes == NULL) {
+        ESP_LOGE(TAG, "no memory for line %d", i);
+        n = 0;
+      }
+    }
+    if (n > 0)
+      memcpy(lines[i].bytes, input[i], n);
+    lines[i].length = n;
+    if (n > longest)
+      longest = n;
+
+    /* the frame is sent when the slowest line has finished */
+    uint32_t f = lines[i].frequency ? lines[i].frequency : 800000;
+    int64_t t = n ? simled_transmit_time(n, f) : 0;
+    if (t > duration)
+      duration = t;
+  }
+
+  frames++;
+  start = esp_timer_get_time();
+  ESP_LOGV(TAG, "frame %d %d bytes %lld us", frames, longest,
+           (long long)duration);
+}
+
+static esp_err_t simled_isFinished() {
+  return esp_timer_get_time() - start >= duration ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+static void simled_stop() { duration = 0; }
+
+static void simled_free() {
+  for (uint8_t i = 0; i < num_lines; i++) {
+    free(lines[i].bytes);
+    lines[i].bytes = NULL;
+    lines[i].size = lines[i].length = 0;
+  }
+  duration = 0;
+}
+
+const uint8_t *simled_get_bytes(uint8_t line, uint32_t *length) {
+  if (line >= num_lines) {
+    *length = 0;
+    return NULL;
+  }
+  *length = lines[line].length;
+  return lines[line].bytes;
+}
+
+uint32_t simled_get_frames() { return frames; }
+
+int64_t simled_get_duration() { return duration; }
+
+const struct OWNLED_DRIVER simled_driver = {
+    .name = "simulator",
+    .init = simled_init,
+    .set_pulses = simled_set_pulses,
+    .send = simled_send,
+    .isFinished = simled_isFinished,
+    .stop = simled_stop,
+    .free = simled_free,
+};
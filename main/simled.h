@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * simled.h
+ *
+ * LED lines simulated without hardware
+ */
+
+#ifndef MAIN_SIMLED_H_
+#define MAIN_SIMLED_H_
+
+#include "ownled.h"
+#include <stdint.h>
+
+/**
+ * simulator without LED hardware. It records the bytes of the last frame and
+ * takes as long to finish as a WS281x line would need to receive them. It
+ * needs only esp_log and esp_timer, so that the host tests run the led task
+ * with it (test/test_simled.c).
+ */
+extern const struct OWNLED_DRIVER simled_driver;
+
+const uint8_t *simled_get_bytes(uint8_t line, uint32_t *length);
+uint32_t simled_get_frames();
+int64_t simled_get_duration();
+int64_t simled_transmit_time(uint32_t bytes, uint32_t frequency);
+
+#endif /* MAIN_SIMLED_H_ */
@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * spiled.c
+ *
+ * clocked LED lines (APA102, SK9822) sent by the SPI units
+ */
+
+#include "spiled.h"
+
+#include "driver/spi_master.h"
+#include "esp_log.h"
+#include "fastrmt.h"
+#include "sdkconfig.h"
+
+#if CONFIG_CONTROLLER_LED_SPI
+
+static const char *TAG = "#spiled";
+
+/** start frame, pixels, reset frame and end frame */
+#define SPILED_MAX_TRANSFER                                                    \
+  (4 + FASTRMT_MAXIMAL_LEDS * 4 + 4 + FASTRMT_MAXIMAL_LEDS / 16 + 4)
+
+static struct {
+  spi_host_device_t host;
+  int dma;
+  uint8_t clock;
+  int16_t line;
+  spi_device_handle_t device;
+  spi_transaction_t transaction;
+  bool busy;
+} units[SPILED_MAXIMAL_LINES] = {
+    {.host = HSPI_HOST,
+     .dma = 1,
+     .clock = CONFIG_CONTROLLER_LED_SPI_CLOCK0,
+     .line = -1},
+    {.host = VSPI_HOST,
+     .dma = 2,
+     .clock = CONFIG_CONTROLLER_LED_SPI_CLOCK1,
+     .line = -1},
+};
+
+/** the clocks must not be sent on the GPIO of a LED line */
+static esp_err_t spiled_init(const uint8_t *gpio, uint8_t lines) {
+  for (int i = 0; i < SPILED_MAXIMAL_LINES; i++) {
+    for (uint8_t l = 0; l < lines; l++)
+      if (gpio[l] == units[i].clock) {
+        ESP_LOGE(TAG, "clock %d is GPIO %d of line %d", i, gpio[l], l);
+        return ESP_ERR_INVALID_ARG;
+      }
+  }
+  if (units[0].clock == units[1].clock) {
+    ESP_LOGE(TAG, "both clocks are GPIO %d", units[0].clock);
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+/** the clock does not depend on the pulses of the single wire protocol */
+static void spiled_set_pulses(uint8_t line, uint32_t frequency, uint8_t one,
+                              uint8_t zero) {}
+
+static void spiled_send(uint8_t *const *input, const uint32_t *length) {
+  for (int i = 0; i < SPILED_MAXIMAL_LINES; i++) {
+    int16_t line = units[i].line;
+    if (line < 0 || units[i].busy || input[line] == NULL || length[line] == 0)
+      continue;
+
+    units[i].transaction.length = length[line] * 8;
+    units[i].transaction.tx_buffer = input[line];
+    if (spi_device_queue_trans(units[i].device, &units[i].transaction, 0) ==
+        ESP_OK)
+      units[i].busy = true;
+  }
+}
+
+static esp_err_t spiled_wait(TickType_t ticks) {
+  esp_err_t res = ESP_OK;
+  for (int i = 0; i < SPILED_MAXIMAL_LINES; i++) {
+    spi_transaction_t *t;
+    if (!units[i].busy)
+      continue;
+    if (spi_device_get_trans_result(units[i].device, &t, ticks) == ESP_OK)
+      units[i].busy = false;
+    else
+      res = ESP_ERR_TIMEOUT;
+  }
+  return res;
+}
+
+static esp_err_t spiled_isFinished() { return spiled_wait(0); }
+
+/** a DMA transfer cannot be aborted, thus wait until the buffer is unused */
+static void spiled_stop() { spiled_wait(portMAX_DELAY); }
+
+static void spiled_detach(uint8_t line) {
+  for (int i = 0; i < SPILED_MAXIMAL_LINES; i++) {
+    if (units[i].line != line)
+      continue;
+    spiled_stop();
+    ESP_ERROR_CHECK(spi_bus_remove_device(units[i].device));
+    ESP_ERROR_CHECK(spi_bus_free(units[i].host));
+    units[i].line = -1;
+    ESP_LOGI(TAG, "line %d detached", line);
+  }
+}
+
+static esp_err_t spiled_attach(uint8_t line, uint8_t gpio) {
+  int i;
+  for (i = 0; i < SPILED_MAXIMAL_LINES; i++)
+    if (units[i].line < 0)
+      break;
+  if (i == SPILED_MAXIMAL_LINES) {
+    ESP_LOGE(TAG, "no SPI unit left for line %d", line);
+    return ESP_ERR_NO_MEM;
+  }
+
+  spi_bus_config_t bus = {
+      .mosi_io_num = gpio,
+      .miso_io_num = -1,
+      .sclk_io_num = units[i].clock,
+      .quadwp_io_num = -1,
+      .quadhd_io_num = -1,
+      .max_transfer_sz = SPILED_MAX_TRANSFER,
+  };
+  spi_device_interface_config_t device = {
+      .mode = 0,
+      .clock_speed_hz = CONFIG_CONTROLLER_LED_SPI_FREQUENCY * 1000000,
+      .spics_io_num = -1,
+      .queue_size = 1,
+  };
+
+  esp_err_t res = spi_bus_initialize(units[i].host, &bus, units[i].dma);
+  if (res != ESP_OK)
+    return res;
+  res = spi_bus_add_device(units[i].host, &device, &units[i].device);
+  if (res != ESP_OK) {
+    spi_bus_free(units[i].host);
+    return res;
+  }
+  units[i].line = line;
+  units[i].busy = false;
+  ESP_LOGI(TAG, "line %d attached to SPI %d, clock %d", line, units[i].host,
+           units[i].clock);
+  return ESP_OK;
+}
+
+static void spiled_free() {
+  for (int i = 0; i < SPILED_MAXIMAL_LINES; i++)
+    if (units[i].line >= 0)
+      spiled_detach(units[i].line);
+}
+
+const struct OWNLED_DRIVER spiled_driver = {
+    .name = "spi",
+    .init = spiled_init,
+    .set_pulses = spiled_set_pulses,
+    .send = spiled_send,
+    .isFinished = spiled_isFinished,
+    .stop = spiled_stop,
+    .free = spiled_free,
+    .attach = spiled_attach,
+    .detach = spiled_detach,
+};
+
+#endif
@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * spiled.h
+ *
+ * clocked LED lines (APA102, SK9822) sent by the SPI units
+ */
+
+#ifndef MAIN_SPILED_H_
+#define MAIN_SPILED_H_
+
+#include "ownled.h"
+
+/** lines, which can be clocked via SPI at the same time */
+#define SPILED_MAXIMAL_LINES (2)
+
+/**
+ * clocked LEDs (APA102, SK9822) on the HSPI and VSPI units with DMA. The data
+ * is sent on the GPIO of the line, the clock on CONFIG_CONTROLLER_LED_SPI_CLOCKx.
+ * A line must be attached before it is used.
+ */
+extern const struct OWNLED_DRIVER spiled_driver;
+
+#endif /* MAIN_SPILED_H_ */
@@ -36,7 +36,11 @@ void status_init() {
   status.ap_size = 0;
   status.ap_records = NULL;
   status.rtp_error = status.rtp_good = status.rtp_loss = 0;
+  status.rtp_reordered = status.rtp_recovered = status.rtp_late = 0;
   status.mjpeg_error = status.mjpeg_good = status.mjpeg_loss = 0;
+  status.mjpeg_partial = 0;
+  status.mjpeg_copied = status.udp_copied = 0;
+  memset(status.mjpeg_drop, 0, sizeof(status.mjpeg_drop));
   status.artnet_good = status.artnet_loss = 0;
   status.led_on_time = status.led_bottom_too_slow = status.led_top_too_slow = 0;
 }
@@ -84,12 +88,29 @@ void status_rtp_loss(int loss) { status.rtp_loss += loss; }
 
 void status_rtp_error() { status.rtp_error++; }
 
-void status_mjpeg_good() { status.mjpeg_good++; }
+void status_rtp_reordered() { status.rtp_reordered++; }
+
+void status_rtp_recovered() { status.rtp_recovered++; }
+
+void status_rtp_late() { status.rtp_late++; }
+
+void status_mjpeg_good(int copied) {
+  status.mjpeg_good++;
+  status.mjpeg_copied = copied;
+}
 
 void status_mjpeg_loss(int loss) { status.mjpeg_loss += loss; }
 
 void status_mjpeg_error() { status.mjpeg_error++; }
 
+void status_mjpeg_partial() { status.mjpeg_partial++; }
+
+void status_mjpeg_drop(enum STATUS_DROP cause, int frames) {
+  status.mjpeg_drop[cause] += frames;
+}
+
+void status_udp_copied(int bytes) { status.udp_copied += bytes; }
+
 void status_artnet_good() { status.artnet_good++; }
 
 void status_artnet_loss(int loss) { status.artnet_loss += loss; }
@@ -16,6 +16,15 @@
 
 #define RTP_LAST_BYTES (32)
 
+/** causes of dropped MJPEG frames */
+enum STATUS_DROP {
+  STATUS_DROP_RING_FULL, /* no free slot for a complete frame */
+  STATUS_DROP_SKIPPED,   /* replaced by a newer frame before decoding */
+  STATUS_DROP_TOO_LARGE, /* larger than MJPEG_MAX_SIZE */
+  STATUS_DROP_NO_MEMORY, /* frame buffer could not grow */
+  STATUS_DROP_CAUSES
+};
+
 struct STATUS {
   char sta[64];
   char ap[64];
@@ -24,7 +33,12 @@ struct STATUS {
   wifi_ap_record_t *ap_records;
   char server[32];
   int rtp_error, rtp_good, rtp_loss;
+  int rtp_reordered, rtp_recovered, rtp_late;
   int mjpeg_error, mjpeg_good, mjpeg_loss;
+  int mjpeg_partial; /* frames decoded with missing restart intervals */
+  int mjpeg_copied; /* payload bytes copied for the last frame */
+  int mjpeg_drop[STATUS_DROP_CAUSES];
+  int udp_copied;   /* RTP bytes copied out of chained pbufs */
   int artnet_error, artnet_good, artnet_loss;
   char rtp_last[RTP_LAST_BYTES * 3 + 2];
   uint32_t led_on_time, led_bottom_too_slow, led_top_too_slow;
@@ -46,12 +60,19 @@ void status_server(const char *);
 void status_rtp_good();
 void status_rtp_loss(int);
 void status_rtp_error();
+void status_rtp_reordered();
+void status_rtp_recovered();
+void status_rtp_late();
 
 void status_rtp_last(uint8_t *, int);
 
-void status_mjpeg_good();
+void status_mjpeg_good(int copied);
 void status_mjpeg_loss(int);
 void status_mjpeg_error();
+void status_mjpeg_partial();
+void status_mjpeg_drop(enum STATUS_DROP, int);
+
+void status_udp_copied(int);
 
 void status_artnet_error();
 void status_artnet_loss(int);
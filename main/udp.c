@@ -11,13 +11,13 @@
 
 #include "udp.h"
 
-#include <netdb.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <sys/types.h>
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/api.h"
+#include "sdkconfig.h"
 
 #include "config.h"
 #include "rtp.h"
@@ -26,74 +26,231 @@
 
 static const char *TAG = "#udp";
 
-static int udp_socket = -1;
+static struct netconn *udp_conn = NULL;
 
 static uint8_t udp_buffer[1501];
 
+/** RTP packets held while waiting for a missing one */
+#define UDP_HOLD_SLOTS (8)
+
+/** time to wait for a missing RTP packet, in microseconds */
+#define UDP_HOLD_TIME (CONFIG_CONTROLLER_RTP_HOLD_MS * 1000ll)
+
+/*
+ * Reorder buffer of one RTP stream (SSRC). Packets ahead of the expected
+ * sequence number are held in slot seq % UDP_HOLD_SLOTS until the gap is
+ * filled or the oldest held packet waited UDP_HOLD_TIME.
+ */
+static struct {
+  struct pbuf *slot[UDP_HOLD_SLOTS];
+  int64_t arrival[UDP_HOLD_SLOTS];
+  uint32_t ssrc;
+  uint16_t expected;
+  bool started;
+  int held;
+} jitter;
+
+static void udp_parse(uint8_t *buffer, int len) {
+  int res = rtp_parse(buffer, len);
+  if (res) {
+    status_rtp_last(buffer, len);
+    status_rtp_error();
+  } else
+    status_rtp_good();
+}
+
+static void jitter_deliver(struct pbuf *p) {
+  udp_parse(p->payload, p->len);
+  pbuf_free(p);
+}
+
+/**
+ * pass the held packets from the expected sequence number on, up to the next
+ * gap
+ */
+static void jitter_drain() {
+  for (;;) {
+    int i = jitter.expected % UDP_HOLD_SLOTS;
+    if (jitter.slot[i] == NULL)
+      return;
+    struct pbuf *p = jitter.slot[i];
+    jitter.slot[i] = NULL;
+    jitter.held--;
+    jitter.expected++;
+    jitter_deliver(p);
+  }
+}
+
+/**
+ * give up waiting for missing packets and pass all held ones in order
+ */
+static void jitter_flush() {
+  while (jitter.held > 0) {
+    while (jitter.slot[jitter.expected % UDP_HOLD_SLOTS] == NULL)
+      jitter.expected++;
+    jitter_drain();
+  }
+}
+
+/**
+ * pass the held packets that waited too long, skipping the missing ones
+ * before them. Returns the time in microseconds until the next one expires
+ * or -1 if none is held.
+ */
+static int64_t jitter_expire() {
+  int64_t now = esp_timer_get_time();
+
+  while (jitter.held > 0) {
+    int64_t oldest = INT64_MAX;
+    for (int i = 0; i < UDP_HOLD_SLOTS; i++)
+      if (jitter.slot[i] != NULL && jitter.arrival[i] < oldest)
+        oldest = jitter.arrival[i];
+    if (now - oldest < UDP_HOLD_TIME)
+      return oldest + UDP_HOLD_TIME - now;
+
+    while (jitter.slot[jitter.expected % UDP_HOLD_SLOTS] == NULL)
+      jitter.expected++;
+    jitter_drain();
+  }
+  return -1;
+}
+
+/**
+ * sort a RTP packet into the stream. The packet is a single pbuf, which is
+ * freed after it has been parsed.
+ */
+static void jitter_receive(struct pbuf *p) {
+  const uint8_t *h = p->payload;
+  if (UDP_HOLD_TIME == 0 || p->len < 12) {
+    jitter_deliver(p);
+    return;
+  }
+
+  uint16_t seq = h[2] << 8 | h[3];
+  uint32_t ssrc = h[8] << 24 | h[9] << 16 | h[10] << 8 | h[11];
+  int16_t d = seq - jitter.expected;
+
+  /* a new stream or a jump of the sequence numbers */
+  if (!jitter.started || ssrc != jitter.ssrc || d >= UDP_HOLD_SLOTS ||
+      d <= -UDP_HOLD_SLOTS) {
+    jitter_flush();
+    jitter.started = true;
+    jitter.ssrc = ssrc;
+    jitter.expected = seq;
+    d = 0;
+  }
+
+  if (d < 0) {
+    ESP_LOGD(TAG, "late packet %u expected %u", seq, jitter.expected);
+    status_rtp_late();
+    pbuf_free(p);
+    return;
+  }
+
+  int i = seq % UDP_HOLD_SLOTS;
+  if (jitter.slot[i] != NULL) {
+    ESP_LOGD(TAG, "duplicate packet %u", seq);
+    pbuf_free(p);
+    return;
+  }
+
+  if (d > 0)
+    status_rtp_reordered();
+  else if (jitter.held > 0)
+    status_rtp_recovered();
+
+  jitter.slot[i] = p;
+  jitter.held++;
+  jitter.arrival[i] = esp_timer_get_time();
+  jitter_drain();
+}
+
 // UDP Listener
 
 void udp_on() {
 
-  // bind to socket
+  // bind to port
   ESP_LOGD(TAG, "bind_udp_server port:%d", config_get_udp_port());
-  udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
-  if (udp_socket < 0) {
-    ESP_LOGE(TAG, "socket %d %s", udp_socket, strerror(udp_socket));
+  udp_conn = netconn_new(NETCONN_UDP);
+  if (udp_conn == NULL) {
+    ESP_LOGE(TAG, "netconn_new failed");
     ESP_ERROR_CHECK(ESP_FAIL);
   }
 
-  struct sockaddr_in server_addr;
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(config_get_udp_port());
-  server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-  if (bind(udp_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
-      0) {
-    ESP_LOGE(TAG, "socket %d %s", udp_socket, strerror(udp_socket));
+  err_t err = netconn_bind(udp_conn, IP_ADDR_ANY, config_get_udp_port());
+  if (err != ERR_OK) {
+    ESP_LOGE(TAG, "bind %d %s", err, lwip_strerr(err));
     udp_off();
     ESP_ERROR_CHECK(ESP_FAIL);
   }
 
-  ESP_LOGD(TAG, "socket created without errors");
+  ESP_LOGD(TAG, "netconn created without errors");
 }
 
 void udp_off() {
-  if (udp_socket >= 0) {
-    close(udp_socket);
-    udp_socket = -1;
+  jitter_flush();
+  jitter.started = false;
+  if (udp_conn != NULL) {
+    netconn_delete(udp_conn);
+    udp_conn = NULL;
   }
 }
 
 void udp_process(int8_t wait) {
 
-  if (udp_socket < 0)
+  if (udp_conn == NULL)
     return;
 
-  struct sockaddr_in si_other;
-  socklen_t si_len = sizeof(si_other);
+  /* wake up when a held packet expires */
+  int64_t hold = jitter_expire();
+  netconn_set_nonblocking(udp_conn, !wait);
+  netconn_set_recvtimeout(udp_conn, hold < 0 ? 0 : hold / 1000 + 1);
 
-  int len =
-      recvfrom(udp_socket, udp_buffer, sizeof(udp_buffer) - 1,
-               wait ? 0 : MSG_DONTWAIT, (struct sockaddr *)&si_other, &si_len);
-  if (len < 0) {
-    if (errno == EAGAIN)
-      return;
-    ESP_LOGE(TAG, "recv %d %d %s", len, errno, strerror(errno));
+  struct netbuf *nb;
+  err_t err = netconn_recv(udp_conn, &nb);
+  if (err == ERR_WOULDBLOCK || err == ERR_TIMEOUT) {
+    jitter_expire();
+    return;
+  }
+  if (err != ERR_OK) {
+    ESP_LOGE(TAG, "recv %d %s", err, lwip_strerr(err));
     ESP_ERROR_CHECK(ESP_FAIL);
   }
+
+  struct pbuf *p = netbuf_pbuf(nb);
+  uint8_t *buffer = p->payload;
+  int len = p->tot_len;
   if (len == 0) {
     ESP_LOGD(TAG, "recv no packet");
     ESP_ERROR_CHECK(ESP_FAIL);
   }
 
-  udp_buffer[len] = 0;
-  ESP_LOGD(TAG, "Received packet from %s:%d", inet_ntoa(si_other.sin_addr),
-           ntohs(si_other.sin_port));
-  //	ESP_LOGI(TAG, "Data: %d -- %s\n", len, udp_buffer);
+  ESP_LOGD(TAG, "Received packet from %s:%d",
+           ipaddr_ntoa(netbuf_fromaddr(nb)), netbuf_fromport(nb));
 
-  int res = rtp_parse(udp_buffer, len);
-  if (res) {
-    status_rtp_last(udp_buffer, len);
-    status_rtp_error();
-  } else
-    status_rtp_good();
+  /*
+   * RTP packets (version 2) are parsed in the buffer of lwIP, so their
+   * payload is copied once, into the frame. Chained pbufs are copied into a
+   * single one. The text based protocols, which need a terminating zero, go
+   * to udp_buffer.
+   */
+  if ((buffer[0] & 0xC0) != 0x80) {
+    len = netbuf_copy(nb, udp_buffer, sizeof(udp_buffer) - 1);
+    udp_buffer[len] = 0;
+    //	ESP_LOGI(TAG, "Data: %d -- %s\n", len, udp_buffer);
+    udp_parse(udp_buffer, len);
+  } else if (p->len != len) {
+    struct pbuf *q = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (q != NULL) {
+      pbuf_copy(q, p);
+      status_udp_copied(len);
+      jitter_receive(q);
+    } else
+      ESP_LOGE(TAG, "no memory for a packet of %d bytes", len);
+  } else {
+    pbuf_ref(p);
+    jitter_receive(p);
+  }
+
+  netbuf_delete(nb);
 }
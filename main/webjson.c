@@ -12,6 +12,7 @@
 #include <time.h>
 
 #include "config.h"
+#include "fastrmt.h"
 #include "ownled.h"
 #include "playlist.h"
 #include "status.h"
@@ -69,6 +70,11 @@ static cJSON *status_to_json() {
   cJSON_AddItemToObject(json, "rtp_error",
                         cJSON_CreateNumber(status.rtp_error));
   cJSON_AddItemToObject(json, "rtp_loss", cJSON_CreateNumber(status.rtp_loss));
+  cJSON_AddItemToObject(json, "rtp_reordered",
+                        cJSON_CreateNumber(status.rtp_reordered));
+  cJSON_AddItemToObject(json, "rtp_recovered",
+                        cJSON_CreateNumber(status.rtp_recovered));
+  cJSON_AddItemToObject(json, "rtp_late", cJSON_CreateNumber(status.rtp_late));
 
   /* mjpeg */
   cJSON_AddItemToObject(json, "mjpeg_good",
@@ -77,6 +83,26 @@ static cJSON *status_to_json() {
                         cJSON_CreateNumber(status.mjpeg_error));
   cJSON_AddItemToObject(json, "mjpeg_loss",
                         cJSON_CreateNumber(status.mjpeg_loss));
+  cJSON_AddItemToObject(json, "mjpeg_partial",
+                        cJSON_CreateNumber(status.mjpeg_partial));
+  cJSON_AddItemToObject(json, "mjpeg_copied",
+                        cJSON_CreateNumber(status.mjpeg_copied));
+  cJSON *drop = cJSON_CreateObject();
+  cJSON_AddItemToObject(
+      drop, "ring_full",
+      cJSON_CreateNumber(status.mjpeg_drop[STATUS_DROP_RING_FULL]));
+  cJSON_AddItemToObject(
+      drop, "skipped",
+      cJSON_CreateNumber(status.mjpeg_drop[STATUS_DROP_SKIPPED]));
+  cJSON_AddItemToObject(
+      drop, "too_large",
+      cJSON_CreateNumber(status.mjpeg_drop[STATUS_DROP_TOO_LARGE]));
+  cJSON_AddItemToObject(
+      drop, "no_memory",
+      cJSON_CreateNumber(status.mjpeg_drop[STATUS_DROP_NO_MEMORY]));
+  cJSON_AddItemToObject(json, "mjpeg_drop", drop);
+  cJSON_AddItemToObject(json, "udp_copied",
+                        cJSON_CreateNumber(status.udp_copied));
 
   /* artnet */
   cJSON_AddItemToObject(json, "artnet_good",
@@ -94,6 +120,21 @@ static cJSON *status_to_json() {
   cJSON_AddItemToObject(json, "led_top_too_slow",
                         cJSON_CreateNumber(status.led_top_too_slow));
 
+  /* level 5 interrupt of the RMT output, per core */
+  cJSON *isr = cJSON_CreateArray();
+  for (int i = 0; i < 2; i++) {
+    struct FASTRMT_STATS stats = fastrmt_stats[i];
+    cJSON *core = cJSON_CreateObject();
+    cJSON_AddItemToObject(core, "calls", cJSON_CreateNumber(stats.calls));
+    cJSON_AddItemToObject(
+        core, "cycles",
+        cJSON_CreateNumber(stats.cycles_high * 4294967296. + stats.cycles));
+    cJSON_AddItemToObject(core, "max_cycles", cJSON_CreateNumber(stats.max));
+    cJSON_AddItemToObject(core, "late", cJSON_CreateNumber(stats.late));
+    cJSON_AddItemToArray(isr, core);
+  }
+  cJSON_AddItemToObject(json, "led_isr", isr);
+
   /* MAC */
   esp_read_mac(mac, ESP_MAC_WIFI_STA);
   snprintf(line, sizeof(line), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1],
@@ -410,6 +451,7 @@ static const char *parseConfigColor(cJSON *root) {
     return "invalid";
   led_coloring.saturation = (n->valueint + 100) / 100.f;
 
+  led_update_coloring();
   return NULL;
 }
 
@@ -511,6 +553,10 @@ static const char *parseConfigLed(cJSON *root) {
     if (!oy || oy->type != cJSON_Number || oy->valueint < 0)
       return "no leds oy";
 
+    if (sx->valueint * sy->valueint + prefix_leds->valueint >
+        FASTRMT_MAXIMAL_LEDS)
+      return "too many leds";
+
     cJSON *r = cJSON_GetObjectItem(n, "r");
     if (!r || r->type != cJSON_Number || r->valueint < 0 ||
         r->valueint >= LED_ORI_MAXVALUE)
@@ -94,7 +94,7 @@ static struct FX_SEGMENT { // 20 bytes
       aux_param; // auxilary param (usually stores a WS2812FX_color_wheel index)
   uint8_t aux_param2;  // auxilary param (usually stores bitwise options)
   uint16_t aux_param3; // auxilary param (usually stores a segment index)
-} fx_segments[8];
+} fx_segments[LED_MAXIMAL_LINES];
 
 #define CYCLE (uint8_t)0x40
 
@@ -113,7 +113,7 @@ static uint16_t segmentLength(int line) {
 #define DEFAULT_SPEED (uint16_t)1000
 
 void WS2812FX_init(int line, int n) {
-  assert(line >= 0 && line < 8);
+  assert(line >= 0 && line < LED_MAXIMAL_LINES);
   memset(fx_segments + line, 0, sizeof(*fx_segments));
   fx_segments[line].mode = DEFAULT_MODE;
   fx_segments[line].colors[0] = RED;
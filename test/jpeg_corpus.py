@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: AGPL-3.0-or-later
+#
+# writes the JPEG files decoded by test_picojpeg into the given directory:
+# smooth and noisy images of several sizes, qualities and subsamplings, with
+# and without restart intervals, and grayscale. The names of the smooth ones
+# end with -smooth, the gradient of 7x9 pixels is too steep to count as such.
+# Needs Pillow.
+
+import os
+import random
+import sys
+
+from PIL import Image
+
+SIZES = [(7, 9), (33, 17), (64, 48), (128, 96), (200, 150), (320, 240)]
+QUALITIES = [5, 50, 90, 100]
+
+
+def image(w, h, noise):
+    img = Image.new('RGB', (w, h))
+    px = img.load()
+    for y in range(h):
+        for x in range(w):
+            if noise:
+                px[x, y] = (random.randrange(256), random.randrange(256),
+                            random.randrange(256))
+            else:
+                px[x, y] = (x * 255 // max(w - 1, 1),
+                            y * 255 // max(h - 1, 1), (x + y) * 3 % 256)
+    return img
+
+
+def h1v2(data):
+    """
+    turns a 4:2:2 file into a 4:4:0 one, which Pillow cannot write. The MCUs
+    keep their two luminance blocks, but are stacked vertically. The image
+    looks garbled but decodes as well as the original.
+    """
+    data = bytearray(data)
+    sof = data.index(b'\xff\xc0')
+    h = data[sof + 5] << 8 | data[sof + 6]
+    w = data[sof + 7] << 8 | data[sof + 8]
+    w, h = (w + 15) // 16 * 8, (h + 7) // 8 * 16
+    data[sof + 5:sof + 9] = bytes([h >> 8, h & 255, w >> 8, w & 255])
+    assert data[sof + 11] == 0x21
+    data[sof + 11] = 0x12
+    return bytes(data)
+
+
+def main(directory):
+    random.seed(7)
+    os.makedirs(directory, exist_ok=True)
+    n = 0
+    suffix = ''
+
+    def save(img, transform=None, **options):
+        nonlocal n
+        name = os.path.join(directory, '%03d%s.jpg' % (n, suffix))
+        img.save(name, **options)
+        if transform:
+            with open(name, 'rb') as f:
+                data = transform(f.read())
+            with open(name, 'wb') as f:
+                f.write(data)
+        n += 1
+
+    for w, h in SIZES:
+        for noise in (False, True):
+            img = image(w, h, noise)
+            suffix = '' if noise or w < 32 else '-smooth'
+            for q in QUALITIES:
+                for subsampling in (0, 1, 2):
+                    save(img, quality=q, subsampling=subsampling)
+                save(img, h1v2, quality=q, subsampling=1)
+                save(img, quality=q, subsampling=2, optimize=True)
+                save(img, quality=q, subsampling=2, restart_marker_blocks=3)
+                save(img, quality=q, subsampling=0, restart_marker_rows=1)
+                save(img.convert('L'), quality=q)
+                save(img.convert('L'), quality=q, restart_marker_blocks=5)
+    print('%d JPEG files in %s' % (n, directory))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1])
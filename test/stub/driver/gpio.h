@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * gpio.h
+ *
+ * host replacement of the ESP-IDF gpio driver, see hardware.c
+ */
+
+#ifndef TEST_DRIVER_GPIO_H_
+#define TEST_DRIVER_GPIO_H_
+
+#include "esp_err.h"
+
+typedef enum { GPIO_MODE_OUTPUT = 2 } gpio_mode_t;
+
+void gpio_pad_select_gpio(uint8_t gpio);
+esp_err_t gpio_set_level(int gpio, uint32_t level);
+esp_err_t gpio_set_direction(int gpio, gpio_mode_t mode);
+
+#endif /* TEST_DRIVER_GPIO_H_ */
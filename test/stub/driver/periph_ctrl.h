@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * periph_ctrl.h
+ *
+ * host replacement of the ESP-IDF peripheral control, see hardware.c
+ */
+
+#ifndef TEST_DRIVER_PERIPH_CTRL_H_
+#define TEST_DRIVER_PERIPH_CTRL_H_
+
+typedef enum { PERIPH_I2S1_MODULE = 4 } periph_module_t;
+
+void periph_module_enable(periph_module_t module);
+void periph_module_disable(periph_module_t module);
+
+#endif /* TEST_DRIVER_PERIPH_CTRL_H_ */
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * spi_master.h
+ *
+ * host replacement of the ESP-IDF SPI master driver, see hardware.c
+ */
+
+#ifndef TEST_DRIVER_SPI_MASTER_H_
+#define TEST_DRIVER_SPI_MASTER_H_
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include <stddef.h>
+
+typedef enum { HSPI_HOST = 1, VSPI_HOST = 2 } spi_host_device_t;
+typedef struct spi_device *spi_device_handle_t;
+
+typedef struct {
+  size_t length; /* in bits */
+  const void *tx_buffer;
+} spi_transaction_t;
+
+typedef struct {
+  int mosi_io_num;
+  int miso_io_num;
+  int sclk_io_num;
+  int quadwp_io_num;
+  int quadhd_io_num;
+  int max_transfer_sz;
+} spi_bus_config_t;
+
+typedef struct {
+  uint8_t mode;
+  int clock_speed_hz;
+  int spics_io_num;
+  int queue_size;
+} spi_device_interface_config_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host,
+                             const spi_bus_config_t *config, int dma);
+esp_err_t spi_bus_free(spi_host_device_t host);
+esp_err_t spi_bus_add_device(spi_host_device_t host,
+                             const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle,
+                                 spi_transaction_t *transaction,
+                                 TickType_t wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **transaction,
+                                      TickType_t wait);
+
+/** the transaction queued last and the number of transactions so far */
+extern spi_transaction_t host_spi_transaction;
+extern int host_spi_transactions;
+
+#endif /* TEST_DRIVER_SPI_MASTER_H_ */
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * gpio.h
+ *
+ * host replacement of the ESP32 ROM gpio functions, see hardware.c
+ */
+
+#ifndef TEST_ESP32_ROM_GPIO_H_
+#define TEST_ESP32_ROM_GPIO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void gpio_matrix_out(uint32_t gpio, uint32_t signal, bool invert,
+                     bool invert_enable);
+
+#endif /* TEST_ESP32_ROM_GPIO_H_ */
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_attr.h
+ *
+ * host replacement of the ESP-IDF memory placement attributes
+ */
+
+#ifndef TEST_ESP_ATTR_H_
+#define TEST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif /* TEST_ESP_ATTR_H_ */
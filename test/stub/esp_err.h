@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_err.h
+ *
+ * host replacement of the ESP-IDF error codes
+ */
+
+#ifndef TEST_ESP_ERR_H_
+#define TEST_ESP_ERR_H_
+
+#include <assert.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK (0)
+#define ESP_FAIL (-1)
+#define ESP_ERR_NO_MEM (0x101)
+#define ESP_ERR_INVALID_ARG (0x102)
+#define ESP_ERR_INVALID_STATE (0x103)
+#define ESP_ERR_NOT_SUPPORTED (0x106)
+#define ESP_ERR_TIMEOUT (0x107)
+
+#define ESP_ERROR_CHECK(x) assert((x) == ESP_OK)
+
+#endif /* TEST_ESP_ERR_H_ */
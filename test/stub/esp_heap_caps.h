@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_heap_caps.h
+ *
+ * host replacement of the ESP-IDF heap, all memory comes from malloc
+ */
+
+#ifndef TEST_ESP_HEAP_CAPS_H_
+#define TEST_ESP_HEAP_CAPS_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+#define heap_caps_malloc(size, caps) malloc(size)
+#define heap_caps_calloc(n, size, caps) calloc(n, size)
+#define heap_caps_free(p) free(p)
+
+#endif /* TEST_ESP_HEAP_CAPS_H_ */
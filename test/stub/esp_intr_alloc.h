@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_intr_alloc.h
+ *
+ * host replacement of the ESP-IDF interrupt allocation, see hardware.c
+ */
+
+#ifndef TEST_ESP_INTR_ALLOC_H_
+#define TEST_ESP_INTR_ALLOC_H_
+
+#include "esp_err.h"
+
+#define ETS_I2S1_INTR_SOURCE (33)
+#define ESP_INTR_FLAG_LEVEL3 (1 << 3)
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+typedef void *intr_handle_t;
+typedef void (*intr_handler_t)(void *arg);
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler,
+                         void *arg, intr_handle_t *handle);
+esp_err_t esp_intr_free(intr_handle_t handle);
+
+#endif /* TEST_ESP_INTR_ALLOC_H_ */
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_log.h
+ *
+ * host replacement of the ESP-IDF logging. Errors and warnings are printed,
+ * the other levels are compiled but not shown.
+ */
+
+#ifndef TEST_ESP_LOG_H_
+#define TEST_ESP_LOG_H_
+
+#include <stdio.h>
+
+#define ESP_HOST_LOG(show, level, tag, format, ...)                           \
+  do {                                                                         \
+    if (show)                                                                  \
+      fprintf(stderr, level " (%s) " format "\n", tag, ##__VA_ARGS__);       \
+  } while (0)
+
+#define ESP_LOGE(tag, format, ...)                                             \
+  ESP_HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)                                             \
+  ESP_HOST_LOG(1, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)                                             \
+  ESP_HOST_LOG(0, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)                                             \
+  ESP_HOST_LOG(0, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)                                             \
+  ESP_HOST_LOG(0, "V", tag, format, ##__VA_ARGS__)
+
+#endif /* TEST_ESP_LOG_H_ */
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_system.h
+ *
+ * host replacement of the ESP-IDF system header
+ */
+
+#ifndef TEST_ESP_SYSTEM_H_
+#define TEST_ESP_SYSTEM_H_
+
+#include "esp_attr.h"
+#include "esp_err.h"
+#include <stddef.h>
+
+#endif /* TEST_ESP_SYSTEM_H_ */
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_timer.h
+ *
+ * host replacement of the ESP-IDF timer, running on the simulated time of
+ * host.c
+ */
+
+#ifndef TEST_ESP_TIMER_H_
+#define TEST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time();
+
+#endif /* TEST_ESP_TIMER_H_ */
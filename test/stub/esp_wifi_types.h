@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * esp_wifi_types.h
+ *
+ * host replacement of the ESP-IDF wifi types
+ */
+
+#ifndef TEST_ESP_WIFI_TYPES_H_
+#define TEST_ESP_WIFI_TYPES_H_
+
+#include <stdint.h>
+
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t ssid[33];
+  int8_t rssi;
+  int authmode;
+} wifi_ap_record_t;
+
+#endif /* TEST_ESP_WIFI_TYPES_H_ */
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * FreeRTOS.h
+ *
+ * host replacement of FreeRTOS. Tasks do not run by themselves, the tests call
+ * them with host_run. Time is simulated and advances only if a task waits.
+ */
+
+#ifndef TEST_FREERTOS_H_
+#define TEST_FREERTOS_H_
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE (0)
+#define pdTRUE (1)
+#define pdFAIL (0)
+#define pdPASS (1)
+
+#define configTICK_RATE_HZ (100)
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xffffffff)
+
+/* tasks of the host tests do not run in parallel, locks are counters */
+typedef struct {
+  int count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED                                          \
+  { 0 }
+#define portENTER_CRITICAL(mux) assert((mux)->count++ == 0)
+#define portEXIT_CRITICAL(mux) assert(--(mux)->count == 0)
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack,
+                       void *args, UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskSuspend(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+TickType_t xTaskGetTickCount();
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous, TickType_t increment);
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+/**
+ * simulated time in us. host_run calls a task until the time has reached
+ * until, host_delay_hook is called whenever a task waits.
+ */
+extern int64_t host_time;
+extern void (*host_delay_hook)(TickType_t ticks);
+void host_run(TaskFunction_t task, void *args, int64_t until);
+void host_advance(int64_t us);
+TaskFunction_t host_task(TaskHandle_t handle);
+
+#endif /* TEST_FREERTOS_H_ */
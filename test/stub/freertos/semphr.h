@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * semphr.h
+ *
+ * host replacement of FreeRTOS, see FreeRTOS.h
+ */
+
+#include "FreeRTOS.h"
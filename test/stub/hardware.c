@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * hardware.c
+ *
+ * peripherals of the ESP32 as seen by the drivers in the host tests. The
+ * registers are plain memory and the functions do nothing.
+ */
+
+#include "driver/gpio.h"
+#include "driver/periph_ctrl.h"
+#include "driver/spi_master.h"
+#include "esp32/rom/gpio.h"
+#include "esp_intr_alloc.h"
+#include "soc/i2s_struct.h"
+
+i2s_dev_t I2S1;
+
+void gpio_pad_select_gpio(uint8_t gpio) {}
+
+esp_err_t gpio_set_level(int gpio, uint32_t level) { return ESP_OK; }
+
+esp_err_t gpio_set_direction(int gpio, gpio_mode_t mode) { return ESP_OK; }
+
+void gpio_matrix_out(uint32_t gpio, uint32_t signal, bool invert,
+                     bool invert_enable) {}
+
+void periph_module_enable(periph_module_t module) {}
+
+void periph_module_disable(periph_module_t module) {}
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler,
+                         void *arg, intr_handle_t *handle) {
+  *handle = (intr_handle_t)handler;
+  return ESP_OK;
+}
+
+esp_err_t esp_intr_free(intr_handle_t handle) { return ESP_OK; }
+
+/* SPI transactions finish at once */
+spi_transaction_t host_spi_transaction;
+int host_spi_transactions;
+
+static struct spi_device {
+  spi_transaction_t *queued;
+} devices[3];
+
+esp_err_t spi_bus_initialize(spi_host_device_t host,
+                             const spi_bus_config_t *config, int dma) {
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host) { return ESP_OK; }
+
+esp_err_t spi_bus_add_device(spi_host_device_t host,
+                             const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle) {
+  *handle = &devices[host];
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle) { return ESP_OK; }
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle,
+                                 spi_transaction_t *transaction,
+                                 TickType_t wait) {
+  if (handle->queued)
+    return ESP_ERR_TIMEOUT;
+  handle->queued = transaction;
+  host_spi_transaction = *transaction;
+  host_spi_transactions++;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle,
+                                      spi_transaction_t **transaction,
+                                      TickType_t wait) {
+  if (handle->queued == NULL)
+    return ESP_ERR_TIMEOUT;
+  *transaction = handle->queued;
+  handle->queued = NULL;
+  return ESP_OK;
+}
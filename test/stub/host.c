@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * host.c
+ *
+ * FreeRTOS and ESP-IDF functions of the host tests, see FreeRTOS.h
+ */
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+int64_t host_time;
+void (*host_delay_hook)(TickType_t ticks);
+
+static jmp_buf *host_exit;
+static int64_t host_until;
+
+struct HOST_TASK {
+  TaskFunction_t function;
+  void *args;
+};
+
+void host_run(TaskFunction_t task, void *args, int64_t until) {
+  jmp_buf exit;
+
+  host_until = until;
+  host_exit = &exit;
+  if (setjmp(exit) == 0)
+    task(args);
+  host_exit = NULL;
+}
+
+void host_advance(int64_t us) {
+  host_time += us;
+  if (host_exit && host_time >= host_until)
+    longjmp(*host_exit, 1);
+}
+
+int64_t esp_timer_get_time() { return host_time; }
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack,
+                       void *args, UBaseType_t priority, TaskHandle_t *handle) {
+  struct HOST_TASK *t = malloc(sizeof(*t));
+  if (t == NULL)
+    return pdFAIL;
+  t->function = task;
+  t->args = args;
+  *handle = t;
+  return pdPASS;
+}
+
+TaskFunction_t host_task(TaskHandle_t handle) {
+  return ((struct HOST_TASK *)handle)->function;
+}
+
+void vTaskDelete(TaskHandle_t task) { free(task); }
+
+void vTaskSuspend(TaskHandle_t task) {}
+
+void vTaskResume(TaskHandle_t task) {}
+
+TickType_t xTaskGetTickCount() {
+  return host_time / (portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (host_delay_hook)
+    host_delay_hook(ticks);
+  host_advance((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *previous, TickType_t increment) {
+  *previous += increment;
+  if (host_delay_hook)
+    host_delay_hook(increment);
+  int64_t wake = (int64_t)*previous * portTICK_PERIOD_MS * 1000;
+  if (wake > host_time)
+    host_advance(wake - host_time);
+}
+
+/* queues hold one item, as the controller uses them as mailboxes */
+struct HOST_QUEUE {
+  UBaseType_t size;
+  bool full;
+  uint8_t item[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t size) {
+  struct HOST_QUEUE *q = calloc(1, sizeof(*q) + size);
+  if (q)
+    q->size = size;
+  return q;
+}
+
+void vQueueDelete(QueueHandle_t queue) { free(queue); }
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+  struct HOST_QUEUE *q = queue;
+  memcpy(q->item, item, q->size);
+  q->full = true;
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  struct HOST_QUEUE *q = queue;
+  if (!q->full)
+    return pdFALSE;
+  memcpy(item, q->item, q->size);
+  q->full = false;
+  return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return calloc(1, sizeof(int)); }
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { free(semaphore); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+  int *taken = semaphore;
+  if (*taken)
+    return pdFALSE;
+  *taken = 1;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  int *taken = semaphore;
+  *taken = 0;
+  return pdTRUE;
+}
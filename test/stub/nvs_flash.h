@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * nvs_flash.h
+ *
+ * host replacement of the ESP-IDF non volatile storage
+ */
+
+#ifndef TEST_NVS_FLASH_H_
+#define TEST_NVS_FLASH_H_
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle;
+
+#endif /* TEST_NVS_FLASH_H_ */
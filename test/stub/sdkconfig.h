@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * sdkconfig.h
+ *
+ * configuration of the host tests. Tests may predefine any value.
+ */
+
+#ifndef TEST_SDKCONFIG_H_
+#define TEST_SDKCONFIG_H_
+
+#ifndef CONFIG_CONTROLLER_LED_LINES
+#define CONFIG_CONTROLLER_LED_LINES 4
+#endif
+#define CONFIG_CONTROLLER_LED_LINE0 16
+#define CONFIG_CONTROLLER_LED_LINE1 32
+#define CONFIG_CONTROLLER_LED_LINE2 4
+#define CONFIG_CONTROLLER_LED_LINE3 12
+#define CONFIG_CONTROLLER_LED_LINE4 13
+#define CONFIG_CONTROLLER_LED_LINE5 14
+#define CONFIG_CONTROLLER_LED_LINE6 15
+#define CONFIG_CONTROLLER_LED_LINE7 17
+#define CONFIG_CONTROLLER_LED_LINE8 18
+#define CONFIG_CONTROLLER_LED_LINE9 19
+#define CONFIG_CONTROLLER_LED_LINE10 21
+#define CONFIG_CONTROLLER_LED_LINE11 22
+#define CONFIG_CONTROLLER_LED_LINE12 23
+#define CONFIG_CONTROLLER_LED_LINE13 25
+#define CONFIG_CONTROLLER_LED_LINE14 26
+#define CONFIG_CONTROLLER_LED_LINE15 27
+#define CONFIG_CONTROLLER_LED_SIMULATOR 1
+#define CONFIG_CONTROLLER_LED_SPI_CLOCK0 33
+#define CONFIG_CONTROLLER_LED_SPI_CLOCK1 27
+#define CONFIG_CONTROLLER_LED_SPI_FREQUENCY 10
+#ifndef CONFIG_CONTROLLER_LED_FULL_REFRESH
+#define CONFIG_CONTROLLER_LED_FULL_REFRESH 50
+#endif
+
+#endif /* TEST_SDKCONFIG_H_ */
@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * gpio_sig_map.h
+ *
+ * signals of the ESP32 gpio matrix used by the drivers
+ */
+
+#ifndef TEST_SOC_GPIO_SIG_MAP_H_
+#define TEST_SOC_GPIO_SIG_MAP_H_
+
+#define I2S1O_DATA_OUT8_IDX (174)
+
+#endif /* TEST_SOC_GPIO_SIG_MAP_H_ */
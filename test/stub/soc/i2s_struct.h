@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * i2s_struct.h
+ *
+ * registers of the I2S unit used by i2sled.c, without their real layout
+ */
+
+#ifndef TEST_SOC_I2S_STRUCT_H_
+#define TEST_SOC_I2S_STRUCT_H_
+
+#include <stdint.h>
+
+typedef volatile struct {
+  struct {
+    uint32_t tx_reset, tx_fifo_reset, tx_start, tx_right_first, tx_msb_right;
+  } conf;
+  struct {
+    uint32_t out_rst;
+  } lc_conf;
+  union {
+    struct {
+      uint32_t lcd_en;
+    };
+    uint32_t val;
+  } conf2;
+  union {
+    struct {
+      uint32_t tx_bits_mod, tx_bck_div_num;
+    };
+    uint32_t val;
+  } sample_rate_conf;
+  union {
+    struct {
+      uint32_t clka_en, clk_en, clkm_div_a, clkm_div_b, clkm_div_num;
+    };
+    uint32_t val;
+  } clkm_conf;
+  union {
+    struct {
+      uint32_t tx_fifo_mod, tx_fifo_mod_force_en, tx_data_num, dscr_en;
+    };
+    uint32_t val;
+  } fifo_conf;
+  union {
+    struct {
+      uint32_t tx_chan_mod;
+    };
+    uint32_t val;
+  } conf_chan;
+  union {
+    struct {
+      uint32_t tx_pcm_bypass, tx_stop_en;
+    };
+    uint32_t val;
+  } conf1;
+  union {
+    uint32_t val;
+  } timing;
+  union {
+    struct {
+      uint32_t out_eof;
+    };
+    uint32_t val;
+  } int_ena, int_clr, int_st;
+  uint32_t out_eof_des_addr;
+  struct {
+    uint32_t addr, start, stop;
+  } out_link;
+} i2s_dev_t;
+
+extern i2s_dev_t I2S1;
+
+#endif /* TEST_SOC_I2S_STRUCT_H_ */
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * lldesc.h
+ *
+ * DMA descriptor of the ESP32
+ */
+
+#ifndef TEST_SOC_LLDESC_H_
+#define TEST_SOC_LLDESC_H_
+
+#include <stdint.h>
+
+typedef struct lldesc_s {
+  volatile uint32_t size : 12, length : 12, offset : 5, sosf : 1, eof : 1,
+      owner : 1;
+  volatile uint8_t *buf;
+  union {
+    struct lldesc_s *stqe_next;
+  } qe;
+} lldesc_t;
+
+#endif /* TEST_SOC_LLDESC_H_ */
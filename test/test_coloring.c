@@ -0,0 +1,209 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * test_coloring.c
+ *
+ * compares the color pipeline with the floating point transformation it
+ * replaces, measures both and checks that a pipeline still in use is not
+ * rebuilt and that white is handled per line.
+ */
+
+#include "led.c"
+#include "simled.h"
+
+#include <stdio.h>
+#include <time.h>
+
+/** the transformation done by led_set_color before the pipeline existed */
+static void float_color(uint8_t r, uint8_t g, uint8_t b, uint8_t *rgb) {
+  float fr = BYTEtoFLOAT(r);
+  float fg = BYTEtoFLOAT(g);
+  float fb = BYTEtoFLOAT(b);
+  hsv(&fr, &fg, &fb);
+  contrasts(&fr, &fg, &fb);
+  rgb[0] = FLOATtoBYTE(fr);
+  rgb[1] = FLOATtoBYTE(fg);
+  rgb[2] = FLOATtoBYTE(fb);
+}
+
+static const struct {
+  const char *name;
+  struct LED_COLORING coloring;
+  enum COLOR_KERNEL kernel;
+  int tolerance;
+} cases[] = {
+    {"default", {1, 0, 1, 0, 1, 0, 1, 0, 1, 0}, COLOR_IDENTITY, 1},
+    {"contrast", {1.3f, 0.1f, 1, 0, 1, 0, 1, 0, 1, 0}, COLOR_LUT1D, 1},
+    {"red", {1, 0, 0.8f, -0.05f, 1, 0, 1.2f, 0, 1, 0}, COLOR_LUT1D, 1},
+    {"hue", {0.8f, -0.1f, 1, 0, 1, 0, 1, 0, 1.5f, 0.2f}, COLOR_LUT3D, 6},
+    {"pale", {1, 0, 1, 0, 1, 0, 1, 0, 0.3f, -0.5f}, COLOR_LUT3D, 6},
+};
+
+static double seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define BENCH_PIXELS (1 << 16)
+#define BENCH_ROUNDS (64)
+
+static uint8_t bench_in[BENCH_PIXELS][3];
+static uint8_t bench_out[4];
+
+static double bench_float() {
+  double start = seconds();
+  for (int n = 0; n < BENCH_ROUNDS; n++)
+    for (int i = 0; i < BENCH_PIXELS; i++)
+      float_color(bench_in[i][0], bench_in[i][1], bench_in[i][2], bench_out);
+  return BENCH_ROUNDS * BENCH_PIXELS / (seconds() - start);
+}
+
+static double bench_pipeline() {
+  double start = seconds();
+  for (int n = 0; n < BENCH_ROUNDS; n++) {
+    struct COLOR_PIPELINE *cp = led_pipeline_acquire();
+    for (int i = 0; i < BENCH_PIXELS; i++)
+      led_pipeline(cp, 0, i, bench_in[i][0], bench_in[i][1], bench_in[i][2],
+                   -1, bench_out);
+    led_pipeline_release(cp);
+  }
+  return BENCH_ROUNDS * BENCH_PIXELS / (seconds() - start);
+}
+
+static int test_kernels() {
+  int failed = 0;
+
+  for (int i = 0; i < BENCH_PIXELS; i++)
+    for (int c = 0; c < 3; c++)
+      bench_in[i][c] = rand();
+  for (int c = 0; c < LED_MAXIMAL_LINES; c++)
+    for (int i = 0; i < 3; i++)
+      led_config.channel[c].black[i] = -1;
+
+  for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+    led_coloring = cases[k].coloring;
+    led_update_coloring();
+
+    int maximum = 0;
+    struct COLOR_PIPELINE *cp = led_pipeline_acquire();
+    for (int r = 0; r < 256; r++)
+      for (int g = 0; g < 256; g += 3)
+        for (int b = 0; b < 256; b += 5) {
+          uint8_t expected[3], rgbw[4];
+          float_color(r, g, b, expected);
+          led_pipeline(cp, 0, 0, r, g, b, -1, rgbw);
+          for (int c = 0; c < 3; c++)
+            if (abs(expected[c] - rgbw[c]) > maximum)
+              maximum = abs(expected[c] - rgbw[c]);
+        }
+    led_pipeline_release(cp);
+
+    bool ok = cp->kernel == cases[k].kernel && maximum <= cases[k].tolerance;
+    printf("%-8s kernel %d difference %d: float %5.1f pipeline %6.1f "
+           "Mpixel/s %s\n",
+           cases[k].name, cp->kernel, maximum, bench_float() * 1e-6,
+           bench_pipeline() * 1e-6, ok ? "ok" : "FAILED");
+    if (!ok)
+      failed++;
+  }
+  return failed;
+}
+
+/* a writer, e.g. the led task, holding the previous pipeline */
+static struct COLOR_PIPELINE *held;
+static struct COLOR_PIPELINE copy;
+static int waited;
+
+static void release_held(TickType_t ticks) {
+  if (memcmp(held, &copy, sizeof(copy)) != 0)
+    printf("pipeline changed while it is used\n");
+  else
+    waited++;
+  led_pipeline_release(held);
+}
+
+static int test_in_use() {
+  led_coloring = cases[3].coloring;
+  led_update_coloring();
+  held = led_pipeline_acquire();
+  memcpy(&copy, held, sizeof(copy));
+
+  /* the first update uses the other slot, the second one has to wait */
+  host_delay_hook = release_held;
+  led_coloring = cases[4].coloring;
+  led_update_coloring();
+  led_coloring = cases[1].coloring;
+  led_update_coloring();
+  host_delay_hook = NULL;
+
+  bool ok = waited == 1 && pipeline == held && held->kernel == COLOR_LUT1D;
+  printf("pipeline in use: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+/**
+ * white on RGBW lines: extracted from the colors or given by the source with
+ * the contrast and brightness of white. Clocked lines have no white die and
+ * show the white of the source with their colors.
+ */
+static int test_white() {
+  int failed = 0;
+
+  led_coloring = cases[1].coloring;
+  led_update_coloring();
+  ownled_init(&simled_driver);
+  ownled_setColorOrder(OWNLED_GRBW);
+  ownled_setProtocol(0, OWNLED_WS281X);
+  ownled_setProtocol(1, OWNLED_APA102);
+  led_config.channel[0].protocol = OWNLED_WS281X;
+  led_config.channel[1].protocol = OWNLED_APA102;
+
+  struct COLOR_PIPELINE *cp = led_pipeline_acquire();
+  for (int i = 0; i < 256; i += 5) {
+    uint8_t r = i, g = 255 - i, b = i / 2, w = i ^ 0x5A;
+    uint8_t rgbw[4], common[4];
+
+    /* common part of the colors */
+    led_pipeline(cp, 0, 0, r, g, b, -1, rgbw);
+    common[3] = cp->lut[0][r];
+    if (cp->lut[1][g] < common[3])
+      common[3] = cp->lut[1][g];
+    if (cp->lut[2][b] < common[3])
+      common[3] = cp->lut[2][b];
+    common[0] = cp->lut[0][r] - common[3];
+    common[1] = cp->lut[1][g] - common[3];
+    common[2] = cp->lut[2][b] - common[3];
+    if (memcmp(rgbw, common, 4))
+      failed++;
+
+    /* white of the source */
+    led_pipeline(cp, 0, 0, r, g, b, w, rgbw);
+    uint8_t own[4] = {cp->lut[0][r], cp->lut[1][g], cp->lut[2][b],
+                      FLOATtoBYTE(contrast_white(BYTEtoFLOAT(w)))};
+    if (memcmp(rgbw, own, 4))
+      failed++;
+
+    /* clocked line */
+    led_pipeline(cp, 1, 0, r, g, b, w, rgbw);
+    uint8_t mixed[4] = {cp->lut_clocked[0][r + w > 255 ? 255 : r + w],
+                        cp->lut_clocked[1][g + w > 255 ? 255 : g + w],
+                        cp->lut_clocked[2][b + w > 255 ? 255 : b + w], 0};
+    if (memcmp(rgbw, mixed, 4))
+      failed++;
+  }
+  led_pipeline_release(cp);
+  ownled_free();
+
+  printf("white per line: %s\n", failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
+
+int main() {
+  int failed = test_kernels();
+  failed += test_in_use();
+  failed += test_white();
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
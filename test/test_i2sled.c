@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * test_i2sled.c
+ *
+ * decodes the samples of i2sled_encode again for 1 to 16 lines of random
+ * length and measures how many LED bytes are encoded per second.
+ */
+
+#include "i2sled.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BYTES (1000)
+
+static uint8_t data[I2SLED_MAXIMAL_LINES][BYTES];
+static uint16_t samples[BYTES * I2SLED_SAMPLES_PER_BYTE];
+
+/**
+ * decode the pulses of a line. A bit starts high, carries the data and ends
+ * low. Lines which have finished stay low. Return the number of errors.
+ */
+static int decode(int lines, int l, const uint32_t *length) {
+  for (uint32_t p = 0; p < BYTES; p++) {
+    const uint16_t *s = samples + p * I2SLED_SAMPLES_PER_BYTE;
+    bool active = p < length[l];
+    uint8_t byte = 0;
+
+    for (int k = 0; k < 8; k++) {
+      bool high = s[I2SLED_SAMPLE(k * 3 + 0)] >> l & 1;
+      bool bit = s[I2SLED_SAMPLE(k * 3 + 1)] >> l & 1;
+      bool low = s[I2SLED_SAMPLE(k * 3 + 2)] >> l & 1;
+      if (high != active || (bit && !high) || low) {
+        printf("%d lines: line %d byte %d has a wrong pulse\n", lines, l, p);
+        return 1;
+      }
+      byte = byte << 1 | bit;
+    }
+    if (active && byte != data[l][p]) {
+      printf("%d lines: line %d byte %d is %02x instead of %02x\n", lines, l,
+             p, byte, data[l][p]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int test_round_trip() {
+  int errors = 0;
+
+  for (int lines = 1; lines <= I2SLED_MAXIMAL_LINES; lines++) {
+    uint8_t *input[I2SLED_MAXIMAL_LINES];
+    uint32_t length[I2SLED_MAXIMAL_LINES];
+
+    for (int l = 0; l < lines; l++) {
+      input[l] = data[l];
+      length[l] = l == 0 ? BYTES : rand() % BYTES;
+      for (int p = 0; p < BYTES; p++)
+        data[l][p] = rand();
+    }
+
+    /* in chunks, as the interrupt refills the DMA buffers */
+    for (uint32_t p = 0; p < BYTES; p += 40)
+      i2sled_encode(samples + p * I2SLED_SAMPLES_PER_BYTE, input, length,
+                    lines, p, BYTES - p < 40 ? BYTES - p : 40);
+
+    for (int l = 0; l < lines; l++)
+      errors += decode(lines, l, length);
+    for (int l = lines; l < I2SLED_MAXIMAL_LINES; l++)
+      for (int i = 0; i < BYTES * I2SLED_SAMPLES_PER_BYTE; i++)
+        if (samples[i] >> l & 1) {
+          printf("%d lines: unused line %d is not low\n", lines, l);
+          errors++;
+          break;
+        }
+  }
+  printf("round trip of 1 to %d lines: %s\n", I2SLED_MAXIMAL_LINES,
+         errors ? "FAILED" : "ok");
+  return errors;
+}
+
+static void benchmark(int lines) {
+  uint8_t *input[I2SLED_MAXIMAL_LINES];
+  uint32_t length[I2SLED_MAXIMAL_LINES];
+  struct timespec start, end;
+  long bytes = 0;
+
+  for (int l = 0; l < lines; l++) {
+    input[l] = data[l];
+    length[l] = BYTES;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    /* 32 bytes per call, as the DMA buffers of i2sled.c */
+    for (uint32_t p = 0; p + 32 <= BYTES; p += 32)
+      i2sled_encode(samples, input, length, lines, p, 32);
+    bytes += BYTES / 32 * 32 * lines;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+  } while (end.tv_sec - start.tv_sec < 1);
+
+  double seconds =
+      end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  printf("%2d lines: %.1f MB/s\n", lines, bytes / seconds * 1e-6);
+}
+
+int main() {
+  srand(7);
+  int errors = test_round_trip();
+  benchmark(8);
+  benchmark(16);
+  return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * test_mapping.c
+ *
+ * compares the positions of pixels on a LED line with the orientation switch
+ * that led_channel_rgb ran per pixel before the per channel maps existed.
+ * The pixels are written by coordinate and as network blocks, then sent
+ * through ownled to the simulator. Also checks that a map still in use is not
+ * freed.
+ */
+
+#include "led.c"
+
+#include "simled.h"
+#include <stdio.h>
+
+/** the mapping of led_channel_rgb before led_map, -1 if out of range */
+static int reference_index(struct LED_CONFIG_CHANNEL *lc, int x, int y) {
+  x -= lc->ox;
+  y -= lc->oy;
+  int sx = lc->sx;
+  int sy = lc->sy;
+
+  // pixel out of range
+  if (x < 0 || y < 0 || x >= sx || y >= sy)
+    return -1;
+
+  switch (lc->orientation) {
+  case LED_ORI0F_ZIGZAG:
+  case LED_ORI0F_MEANDER:
+    invert(&x, sx);
+    break;
+  case LED_ORI90_ZIGZAG:
+  case LED_ORI90_MEANDER:
+    swap(&sx, &sy);
+    swap(&x, &y);
+    invert(&x, sx);
+    break;
+  case LED_ORI90F_ZIGZAG:
+  case LED_ORI90F_MEANDER:
+    swap(&sx, &sy);
+    swap(&x, &y);
+    invert(&x, sx);
+    invert(&y, sy);
+    break;
+  case LED_ORI180_ZIGZAG:
+  case LED_ORI180_MEANDER:
+    invert(&x, sx);
+    invert(&y, sy);
+    break;
+  case LED_ORI180F_ZIGZAG:
+  case LED_ORI180F_MEANDER:
+    invert(&y, sy);
+    break;
+  case LED_ORI270_ZIGZAG:
+  case LED_ORI270_MEANDER:
+    swap(&sx, &sy);
+    swap(&x, &y);
+    invert(&y, sy);
+    break;
+  case LED_ORI270F_ZIGZAG:
+  case LED_ORI270F_MEANDER:
+    swap(&sx, &sy);
+    swap(&x, &y);
+    break;
+  default:
+    break;
+  }
+
+  switch (lc->orientation) {
+  case LED_ORI0_MEANDER:
+  case LED_ORI0F_MEANDER:
+  case LED_ORI90_MEANDER:
+  case LED_ORI90F_MEANDER:
+  case LED_ORI180_MEANDER:
+  case LED_ORI180F_MEANDER:
+  case LED_ORI270_MEANDER:
+  case LED_ORI270F_MEANDER:
+    if ((y & 1) == 1) {
+      x = sx - x - 1;
+    }
+    break;
+  default:
+    break;
+  }
+
+  return x + y * sx;
+}
+
+#define MAXIMAL_SIZE (9)
+#define MARGIN (2)
+#define AREA (MAXIMAL_SIZE + 2 * MARGIN)
+#define MARKER (0xA5)
+
+/* each pixel of the area has its own color: red and green are its number */
+static uint8_t red[AREA * AREA], green[AREA * AREA], blue[AREA * AREA];
+
+static void configure(enum LED_ORIENTATION orientation, int sx, int sy,
+                      int prefix) {
+  memset(&led_config, 0, sizeof(led_config));
+  led_config.prefix_leds = prefix;
+  struct LED_CONFIG_CHANNEL *lc = &led_config.channel[0];
+  lc->mode = LED_MODE_NETWORK;
+  lc->orientation = orientation;
+  lc->sx = sx;
+  lc->sy = sy;
+  lc->ox = 1;
+  lc->oy = 2;
+  lc->black[0] = lc->black[1] = lc->black[2] = -1;
+  handleNewConfig();
+}
+
+/* compare the line sent with the reference, return the number of errors */
+static int check(const char *path) {
+  struct LED_CONFIG_CHANNEL *lc = &led_config.channel[0];
+  int expected[MAXIMAL_SIZE * MAXIMAL_SIZE];
+  int errors = 0;
+
+  for (int i = 0; i < lc->sx * lc->sy; i++)
+    expected[i] = -1;
+  for (int y = 0; y < AREA; y++)
+    for (int x = 0; x < AREA; x++) {
+      int p = reference_index(lc, x, y);
+      if (p >= 0)
+        expected[p] = x + y * AREA;
+    }
+
+  ownled_send();
+  uint32_t length;
+  const uint8_t *bytes = simled_get_bytes(0, &length);
+  if (length != (lc->sx * lc->sy + led_config.prefix_leds) * 3u)
+    return 1;
+
+  for (int i = 0; i < lc->sx * lc->sy; i++) {
+    const uint8_t *px = bytes + (i + led_config.prefix_leds) * 3;
+    int got = px[2] == MARKER ? px[0] + px[1] * 256 : -1;
+    if (got != expected[i]) {
+      if (errors++ == 0)
+        printf("%s: orientation %d %dx%d led %d shows %d instead of %d\n",
+               path, lc->orientation, lc->sx, lc->sy, i, got, expected[i]);
+    }
+  }
+  return errors;
+}
+
+/* a network task holding the previous map */
+static struct LED_MAP *held;
+static uint16_t copy[MAXIMAL_SIZE * MAXIMAL_SIZE];
+static int waited;
+
+static void release_held(TickType_t ticks) {
+  if (memcmp(held->index, copy, held->sx * held->sy * sizeof(uint16_t)))
+    printf("map changed while it is used\n");
+  else
+    waited++;
+  led_map_release(held);
+}
+
+static int test_in_use() {
+  configure(LED_ORI90_MEANDER, 5, 7, 0);
+  held = led_map_acquire(0);
+  memcpy(copy, held->index, held->sx * held->sy * sizeof(uint16_t));
+
+  host_delay_hook = release_held;
+  configure(LED_ORI180_ZIGZAG, 7, 5, 0);
+  host_delay_hook = NULL;
+
+  struct LED_MAP *m = led_map_acquire(0);
+  bool ok = waited == 1 && m != held && held->index == NULL && m->sx == 7 &&
+            m->index[0] == led_channel_index(&led_config.channel[0], 0, 0);
+  led_map_release(m);
+  printf("map in use: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main() {
+  int errors = 0, checked = 0;
+
+  ownled_init(&simled_driver);
+  ownled_setColorOrder(OWNLED_RGB);
+  led_update_coloring();
+
+  for (int i = 0; i < AREA * AREA; i++) {
+    red[i] = i;
+    green[i] = i >> 8;
+    blue[i] = MARKER;
+  }
+
+  for (int o = 0; o < LED_ORI_MAXVALUE; o++)
+    for (int sx = 1; sx <= MAXIMAL_SIZE; sx++)
+      for (int sy = 1; sy <= MAXIMAL_SIZE; sy++) {
+        int prefix = (sx + sy) & 1;
+
+        /* pixel by pixel, as the test patterns do */
+        configure(o, sx, sy, prefix);
+        for (int y = 0; y < AREA; y++)
+          for (int x = 0; x < AREA; x++)
+            led_channel_rgb(0, x, y, red[x + y * AREA], green[x + y * AREA],
+                            MARKER);
+        errors += check("pixel");
+
+        /* a block of network data covering the channel and its margin */
+        configure(o, sx, sy, prefix);
+        led_write_block(0, 0, AREA, AREA, red, green, blue, AREA);
+        errors += check("block");
+        checked += 2;
+      }
+  errors += test_in_use();
+
+  ownled_free();
+  printf("%d mappings of %d orientations: %s\n", checked, LED_ORI_MAXVALUE,
+         errors ? "FAILED" : "ok");
+  return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
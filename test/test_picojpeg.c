@@ -0,0 +1,419 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * test_picojpeg.c
+ *
+ * decodes the JPEG files written by jpeg_corpus.py and checks that
+ * - full and DC only decoding are bit exact to the baseline picojpeg, with
+ *   the callback and with the memory interface
+ * - pjpeg_skip_mcu keeps the DC prediction, so the MCUs after skipped ones
+ *   are equal to those of a complete decoding
+ * - pjpeg_decode_restart continues at every restart interval with the MCUs
+ *   of a complete decoding
+ * - pjpeg_decode_rescan decodes like pjpeg_decode_init_memory in every
+ *   reduction
+ * - the 1/2 and 1/4 reductions of smooth images are close to the box filtered
+ *   full decoding, per file and on average, and have no bias
+ * and measures the MCUs decoded per second by both versions, unless
+ * NO_BENCHMARK is set in the environment.
+ */
+
+#include "picojpeg.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* picojpeg before the decoder changes, built by the Makefile */
+unsigned char
+baseline_pjpeg_decode_init(pjpeg_image_info_t *pInfo,
+                           pjpeg_need_bytes_callback_t pNeed_bytes_callback,
+                           void *pCallback_data, unsigned char reduce);
+unsigned char baseline_pjpeg_decode_mcu(void);
+
+#define MAXIMAL_SIZE (1 << 20)
+#define MAXIMAL_MCUS (4096)
+#define MCU_BYTES (3 * 256)
+#define REPEAT (10)
+
+enum DECODER { BASELINE, CALLBACK, MEMORY, RESCAN };
+
+static const char *decoder_name[] = {"baseline callback", "callback",
+                                     "memory", "rescan"};
+
+/** pixels per side of a block, by reduction */
+static const int reduced_size[] = {
+    [PJPG_REDUCE_NONE] = 8,
+    [PJPG_REDUCE_8] = 1,
+    [PJPG_REDUCE_2] = 4,
+    [PJPG_REDUCE_4] = 2,
+};
+
+static unsigned char file[MAXIMAL_SIZE];
+static unsigned long file_size, file_pos;
+static unsigned long scan; /* offset of the data following the SOS segment */
+
+/**
+ * mean absolute difference to the box filtered full decoding of a smooth
+ * file, by reduction. On average over all smooth files, the errors must be
+ * smaller and the bias close to zero.
+ */
+static const struct {
+  double file, average, bias;
+} scaled_tolerance[] = {
+    [PJPG_REDUCE_2] = {6, 2.5, 0.25},
+    [PJPG_REDUCE_4] = {10, 4, 0.25},
+};
+static long scaled_error[PJPG_REDUCE_4 + 1], scaled_bias[PJPG_REDUCE_4 + 1];
+static long scaled_pixels[PJPG_REDUCE_4 + 1];
+
+static uint8_t reference[MAXIMAL_MCUS][MCU_BYTES];
+static uint8_t decoded[MAXIMAL_MCUS][MCU_BYTES];
+static int reference_mcus;
+
+static unsigned char need_bytes(unsigned char *pBuf, unsigned char buf_size,
+                                unsigned char *pBytes_actually_read,
+                                void *pCallback_data) {
+  unsigned long n = file_size - file_pos;
+  if (n > buf_size)
+    n = buf_size;
+  memcpy(pBuf, file + file_pos, n);
+  file_pos += n;
+  *pBytes_actually_read = n;
+  return 0;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/** read a whole file and find the entropy coded data */
+static bool load(const char *name) {
+  FILE *f = fopen(name, "rb");
+  if (f == NULL)
+    return false;
+  file_size = fread(file, 1, sizeof(file), f);
+  bool complete = feof(f);
+  fclose(f);
+  if (!complete)
+    return false;
+
+  for (scan = 2; scan + 4 <= file_size; scan++)
+    if (file[scan] == 0xFF && file[scan + 1] == 0xDA) {
+      scan += 2 + (file[scan + 2] << 8 | file[scan + 3]);
+      return true;
+    }
+  return false;
+}
+
+/** the restart interval of the file, in MCUs, or 0 */
+static int restart_interval() {
+  for (unsigned long i = 2; i + 6 <= scan; i++)
+    if (file[i] == 0xFF && file[i + 1] == 0xDD)
+      return file[i + 4] << 8 | file[i + 5];
+  return 0;
+}
+
+/**
+ * offsets of the blocks of a MCU in its buffers, see pjpeg_image_info_t.
+ * Return the number of blocks.
+ */
+static int blocks(const pjpeg_image_info_t *info, int offset[4]) {
+  switch (info->m_scanType) {
+  case PJPG_YH2V1:
+    offset[1] = 64;
+    break;
+  case PJPG_YH1V2:
+    offset[1] = 128;
+    break;
+  case PJPG_YH2V2:
+    offset[1] = 64;
+    offset[2] = 128;
+    offset[3] = 192;
+    break;
+  default:
+    break;
+  }
+  offset[0] = 0;
+  return info->m_MCUWidth / 8 * info->m_MCUHeight / 8;
+}
+
+/** copy the pixels of the decoded MCU, which are valid in this reduction */
+static void copy(const pjpeg_image_info_t *info, uint8_t *mcu,
+                 unsigned char reduce) {
+  const uint8_t *buffer[3] = {info->m_pMCUBufR, info->m_pMCUBufG,
+                              info->m_pMCUBufB};
+  int offset[4], n = reduced_size[reduce];
+  int count = blocks(info, offset);
+
+  memset(mcu, 0, MCU_BYTES);
+  for (int c = 0; c < (info->m_comps == 1 ? 1 : 3); c++)
+    for (int b = 0; b < count; b++)
+      for (int y = 0; y < n; y++)
+        memcpy(mcu + c * 256 + offset[b] + y * 8,
+               buffer[c] + offset[b] + y * 8, n);
+}
+
+/**
+ * decode all MCUs of the file into mcus, skipping every skip-th MCU if skip
+ * is not zero. Return the number of MCUs or -1 on errors.
+ */
+static int decode(enum DECODER decoder, unsigned char reduce, int skip,
+                  uint8_t mcus[][MCU_BYTES]) {
+  pjpeg_image_info_t info;
+  unsigned char res;
+
+  file_pos = 0;
+  switch (decoder) {
+  case BASELINE:
+    res = baseline_pjpeg_decode_init(&info, need_bytes, NULL, reduce);
+    break;
+  case CALLBACK:
+    res = pjpeg_decode_init(&info, need_bytes, NULL, reduce);
+    break;
+  case MEMORY:
+    res = pjpeg_decode_init_memory(&info, file, file_size, reduce);
+    break;
+  default:
+    /* the tables of a decoding with another reduction are kept */
+    res = pjpeg_decode_init_memory(&info, file, file_size, reduce ^ 1);
+    if (res == 0)
+      res = pjpeg_decode_rescan(&info, file + scan, file_size - scan, reduce);
+    break;
+  }
+  if (res)
+    return -1;
+
+  for (int no = 0; no < MAXIMAL_MCUS; no++) {
+    bool skipped = skip && no % skip == 0;
+    if (decoder == BASELINE)
+      res = baseline_pjpeg_decode_mcu();
+    else
+      res = skipped ? pjpeg_skip_mcu() : pjpeg_decode_mcu();
+    if (res == PJPG_NO_MORE_BLOCKS)
+      return no;
+    if (res)
+      return -1;
+    if (mcus && !skipped)
+      copy(&info, mcus[no], reduce);
+  }
+  return -1;
+}
+
+static int compare(const char *name, const char *what, int mcus, int first,
+                   int skip) {
+  for (int no = first; no < mcus; no++) {
+    if (skip && no % skip == 0)
+      continue;
+    if (memcmp(reference[no], decoded[no], MCU_BYTES)) {
+      printf("%s: %s differs at MCU %d\n", name, what, no);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * continue the decoding at every restart interval. The MCUs up to the end of
+ * the file must equal those of the reference.
+ */
+static int check_restarts(const char *name) {
+  int interval = restart_interval();
+  if (interval == 0)
+    return 0;
+
+  pjpeg_image_info_t info;
+  int k = 1;
+  for (unsigned long i = scan; i + 1 < file_size; i++) {
+    if (file[i] != 0xFF || (file[i + 1] & 0xF8) != 0xD0)
+      continue;
+    unsigned long start = i + 2;
+    if (pjpeg_decode_init_memory(&info, file, file_size, 0) ||
+        pjpeg_decode_restart(k, file + start, file_size - start)) {
+      printf("%s: restart interval %d fails\n", name, k);
+      return 1;
+    }
+    int no = k * interval;
+    unsigned char res;
+    while ((res = pjpeg_decode_mcu()) == 0 && no < MAXIMAL_MCUS)
+      copy(&info, decoded[no++], PJPG_REDUCE_NONE);
+    if (res != PJPG_NO_MORE_BLOCKS || no != reference_mcus) {
+      printf("%s: restart interval %d ends at MCU %d with %d\n", name, k, no,
+             res);
+      return 1;
+    }
+    if (compare(name, "restart", no, k * interval, 0))
+      return 1;
+    k++;
+  }
+  return 0;
+}
+
+/**
+ * compare the reductions of a smooth image with the box filtered full
+ * decoding and add the differences to the averages
+ */
+static int check_scaled(const char *name) {
+  pjpeg_image_info_t info;
+  int offset[4];
+
+  if (pjpeg_decode_init_memory(&info, file, file_size, PJPG_REDUCE_NONE))
+    return 1;
+  int count = blocks(&info, offset);
+  int comps = info.m_comps == 1 ? 1 : 3;
+  int mcus = decode(MEMORY, PJPG_REDUCE_NONE, 0, reference);
+  int errors = 0;
+
+  for (unsigned char reduce = PJPG_REDUCE_2; reduce <= PJPG_REDUCE_4;
+       reduce++) {
+    int n = reduced_size[reduce], f = 8 / n;
+    long error = 0, bias = 0, pixels = 0;
+    if (decode(MEMORY, reduce, 0, decoded) != mcus)
+      return 1;
+    for (int no = 0; no < mcus; no++)
+      for (int c = 0; c < comps; c++)
+        for (int b = 0; b < count; b++)
+          for (int y = 0; y < n; y++)
+            for (int x = 0; x < n; x++) {
+              const uint8_t *full = reference[no] + c * 256 + offset[b];
+              int box = f * f / 2;
+              for (int i = 0; i < f * f; i++)
+                box += full[(y * f + i / f) * 8 + x * f + i % f];
+              int d = decoded[no][c * 256 + offset[b] + y * 8 + x] -
+                      box / (f * f);
+              error += abs(d);
+              bias += d;
+              pixels++;
+            }
+    if (error > scaled_tolerance[reduce].file * pixels) {
+      printf("%s: 1/%d differs by %.2f from the full decoding\n", name, f,
+             (double)error / pixels);
+      errors++;
+    }
+    scaled_error[reduce] += error;
+    scaled_bias[reduce] += bias;
+    scaled_pixels[reduce] += pixels;
+  }
+  return errors;
+}
+
+static int check(const char *name) {
+  int errors = 0;
+
+  /* full and DC only decoding equal the baseline */
+  for (unsigned char reduce = PJPG_REDUCE_NONE; reduce <= PJPG_REDUCE_8;
+       reduce++) {
+    int mcus = decode(BASELINE, reduce, 0, reference);
+    if (mcus < 0) {
+      printf("%s: the baseline cannot decode it\n", name);
+      return 1;
+    }
+    for (enum DECODER d = CALLBACK; d <= RESCAN; d++) {
+      memset(decoded, 0, sizeof(decoded));
+      if (decode(d, reduce, 0, decoded) != mcus) {
+        printf("%s: %s has not %d MCUs\n", name, decoder_name[d], mcus);
+        errors++;
+      } else
+        errors += compare(name, decoder_name[d], mcus, 0, 0);
+    }
+  }
+
+  /* the reductions, which the baseline does not have, and skipped MCUs */
+  for (unsigned char reduce = PJPG_REDUCE_NONE; reduce <= PJPG_REDUCE_4;
+       reduce++) {
+    reference_mcus = decode(MEMORY, reduce, 0, reference);
+    if (decode(RESCAN, reduce, 0, decoded) != reference_mcus)
+      errors++;
+    else
+      errors += compare(name, "rescan", reference_mcus, 0, 0);
+    for (int skip = 1; skip <= 3; skip++) {
+      if (decode(MEMORY, reduce, skip, decoded) != reference_mcus)
+        errors++;
+      else
+        errors += compare(name, "skip", reference_mcus, 0, skip);
+    }
+  }
+
+  reference_mcus = decode(MEMORY, PJPG_REDUCE_NONE, 0, reference);
+  errors += check_restarts(name);
+  if (strstr(name, "-smooth"))
+    errors += check_scaled(name);
+  return errors;
+}
+
+static int by_name(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int main(int argc, char **argv) {
+  const char *directory = argc > 1 ? argv[1] : "corpus";
+  char *names[1024];
+  int files = 0, errors = 0;
+
+  DIR *dir = opendir(directory);
+  if (dir == NULL) {
+    printf("no corpus in %s, see jpeg_corpus.py\n", directory);
+    return 1;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL && files < 1024) {
+    size_t length = strlen(entry->d_name);
+    if (length < 4 || strcmp(entry->d_name + length - 4, ".jpg"))
+      continue;
+    names[files] = malloc(strlen(directory) + length + 2);
+    sprintf(names[files], "%s/%s", directory, entry->d_name);
+    files++;
+  }
+  closedir(dir);
+  qsort(names, files, sizeof(names[0]), by_name);
+
+  int repeat = getenv("NO_BENCHMARK") ? 0 : REPEAT;
+  double seconds[RESCAN + 1][2] = {{0}};
+  long mcus[2] = {0};
+  for (int i = 0; i < files; i++) {
+    if (!load(names[i])) {
+      printf("%s: cannot be read or has no scan\n", names[i]);
+      errors++;
+      continue;
+    }
+    errors += check(names[i]);
+
+    for (unsigned char reduce = PJPG_REDUCE_NONE;
+         repeat > 0 && reduce <= PJPG_REDUCE_8; reduce++) {
+      for (enum DECODER d = BASELINE; d <= MEMORY; d++) {
+        double start = now();
+        for (int r = 0; r < repeat; r++)
+          decode(d, reduce, 0, NULL);
+        seconds[d][reduce] += now() - start;
+      }
+      mcus[reduce] += (long)repeat * decode(MEMORY, reduce, 0, NULL);
+    }
+    free(names[i]);
+  }
+
+  for (unsigned char reduce = PJPG_REDUCE_2; reduce <= PJPG_REDUCE_4;
+       reduce++) {
+    double error = (double)scaled_error[reduce] / scaled_pixels[reduce];
+    double bias = (double)scaled_bias[reduce] / scaled_pixels[reduce];
+    bool ok = error <= scaled_tolerance[reduce].average &&
+              fabs(bias) <= scaled_tolerance[reduce].bias;
+    printf("1/%d of smooth files: error %.2f bias %+.3f %s\n",
+           8 / reduced_size[reduce], error, bias, ok ? "ok" : "FAILED");
+    if (!ok)
+      errors++;
+  }
+  for (enum DECODER d = BASELINE; repeat > 0 && d <= MEMORY; d++)
+    printf("%-18s %9.0f MCUs/s full %9.0f MCUs/s DC only\n", decoder_name[d],
+           mcus[0] / seconds[d][0], mcus[1] / seconds[d][1]);
+  printf("%d JPEG files: %s\n", files, errors || files == 0 ? "FAILED" : "ok");
+  return errors || files == 0 ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * test_simled.c
+ *
+ * runs the led task with the simulator driver on simulated time: frame
+ * pacing, test patterns, network data, partial frames and lines that take
+ * longer to send than a frame lasts.
+ */
+
+#include "led.c"
+
+#include "simled.h"
+#include <stdio.h>
+
+extern int host_led_on_time, host_led_too_slow, host_led_too_late;
+
+#define SECOND (1000000LL)
+
+static int errors;
+
+static void expect(bool ok, const char *what) {
+  printf("%-40s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    errors++;
+}
+
+/* bytes sent per line and status of the frames since the last reset */
+static uint32_t frames;
+static uint64_t sent[OWNLED_MAXIMAL_LINES];
+
+static void reset() {
+  frames = simled_get_frames();
+  memset(sent, 0, sizeof(sent));
+  host_led_on_time = host_led_too_slow = host_led_too_late = 0;
+}
+
+static void channel(struct LED_CONFIG *config, int c, enum LED_MODE mode,
+                    int sx, int sy) {
+  struct LED_CONFIG_CHANNEL *lc = &config->channel[c];
+  lc->mode = mode;
+  lc->sx = sx;
+  lc->sy = sy;
+  lc->black[0] = lc->black[1] = lc->black[2] = -1;
+}
+
+static struct LED_CONFIG config;
+static uint32_t first;
+
+/* a red line and a line showing network data, 50 frames per second */
+static void configure() {
+  memset(&config, 0, sizeof(config));
+  config.refresh_rate = 50;
+  channel(&config, 0, LED_MODE_RED, 10, 1);
+  channel(&config, 1, LED_MODE_NETWORK, 20, 1);
+  led_set_config(&config);
+}
+
+static void measure() {
+  reset();
+  first = simled_get_frames();
+}
+
+static void check_frame_rate() {
+  uint32_t n = simled_get_frames() - first;
+  printf("%d frames per second\n", n);
+  expect(n == 50, "frame rate");
+  expect(host_led_on_time == 50 && !host_led_too_slow && !host_led_too_late,
+         "frames on time");
+
+  uint32_t length;
+  const uint8_t *bytes = simled_get_bytes(0, &length);
+  bool red = length == 30;
+  for (uint32_t i = 0; red && i < length; i += 3)
+    red = bytes[i] == 0 && bytes[i + 1] == 255 && bytes[i + 2] == 0;
+  expect(red, "red line in GRB order");
+}
+
+/* a row of network data shows up with the next frame */
+static void write_row() {
+  uint8_t r[10], g[10], b[10];
+  for (int i = 0; i < 10; i++) {
+    r[i] = i;
+    g[i] = 100 + i;
+    b[i] = 200 + i;
+  }
+  led_write_row(5, 0, 10, r, g, b, 1);
+}
+
+static void check_row() {
+  uint32_t length;
+  const uint8_t *bytes = simled_get_bytes(1, &length);
+  bool shown = length >= 45;
+  for (int i = 0; shown && i < 10; i++)
+    shown = bytes[15 + i * 3] == 100 + i && bytes[16 + i * 3] == i &&
+            bytes[17 + i * 3] == 200 + i;
+  expect(shown, "network row");
+  reset();
+}
+
+/* unchanged lines are sent only with the full refresh, 1 of 50 frames */
+static void check_partial() {
+  printf("bytes per second: line 0 %d, line 1 %d\n", (int)sent[0],
+         (int)sent[1]);
+  expect(sent[0] == 30 && sent[1] == 60, "partial frames");
+}
+
+/**
+ * a line of 1000 LEDs needs 30 ms, the frames of 20 ms are too short. The
+ * line shows a stream, so that each frame is sent completely.
+ */
+static bool streaming;
+
+static void stream() {
+  static uint8_t level[1000];
+  memset(level, simled_get_frames(), sizeof(level));
+  led_write_row(0, 1, 1000, level, level, level, 1);
+}
+
+static void configure_long() {
+  channel(&config, 2, LED_MODE_NETWORK, 1000, 1);
+  config.channel[2].oy = 1;
+  led_set_config(&config);
+  streaming = true;
+}
+
+static void check_too_slow() {
+  uint32_t n = simled_get_frames() - first;
+  printf("%d frames per second, %d too slow\n", n, host_led_too_slow);
+  expect(simled_get_duration() == simled_transmit_time(3000, 800000),
+         "transmission time");
+  expect(n == 25 && host_led_too_slow == 25, "frames too slow");
+}
+
+/* what happens next to the led task, in us of simulated time */
+static const struct {
+  int64_t time;
+  void (*step)();
+} steps[] = {
+    {0, configure},
+    {3 * SECOND, measure},
+    {4 * SECOND, check_frame_rate},
+    {4 * SECOND, write_row},
+    {4 * SECOND + SECOND / 50, check_row},
+    {5 * SECOND + 50000, check_partial},
+    {5 * SECOND + 50000, configure_long},
+    {6 * SECOND, measure},
+    {7 * SECOND, check_too_slow},
+};
+
+#define STEPS (sizeof(steps) / sizeof(steps[0]))
+
+static int next;
+
+/* called whenever the led task waits */
+static void step(TickType_t ticks) {
+  if (simled_get_frames() != frames) {
+    frames = simled_get_frames();
+    for (int i = 0; i < ownled_getChannels(); i++) {
+      uint32_t length;
+      simled_get_bytes(i, &length);
+      sent[i] += length;
+    }
+  }
+  if (streaming)
+    stream();
+  while (next < STEPS && host_time >= steps[next].time)
+    steps[next++].step();
+}
+
+int main() {
+  led_update_coloring();
+  led_on();
+
+  host_delay_hook = step;
+  host_run(host_task(taskHandle), NULL, steps[STEPS - 1].time + SECOND);
+  host_delay_hook = NULL;
+
+  led_off();
+  expect(next == STEPS, "all steps run");
+  return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
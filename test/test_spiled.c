@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * test_spiled.c
+ *
+ * checks the frames of clocked APA102 lines as they are handed to the SPI
+ * unit: start frame, brightness byte, BGR order and end frame. Clocks on the
+ * GPIO of a LED line are refused.
+ */
+
+#include "driver/spi_master.h"
+#include "ownled.h"
+#include "sdkconfig.h"
+#include "simled.h"
+#include "spiled.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LINE (1)
+
+static int check(uint16_t n, uint8_t brightness) {
+  uint8_t rgbw[4] = {0, 0, 0, 0};
+  int errors = 0;
+
+  ownled_setSize(LINE, n);
+  ownled_setGlobalBrightness(brightness);
+  /* every LED but the first one gets a color of its own */
+  for (uint16_t p = 1; p < n; p++) {
+    rgbw[0] = p;
+    rgbw[1] = p >> 8;
+    rgbw[2] = 0x80 | p % 64;
+    ownled_setPixels(LINE, NULL, p, 1, rgbw, 0);
+  }
+
+  int before = host_spi_transactions;
+  ownled_send();
+  while (ownled_isFinished() != ESP_OK)
+    ;
+  if (host_spi_transactions != before + 1) {
+    printf("%d LEDs: frame not sent\n", n);
+    return 1;
+  }
+
+  /* 32 zero bits, 32 bits per LED, 32 zero bits for SK9822, a clock edge
+   * per two LEDs, in whole words */
+  size_t end = 4 + (n + 15) / 16;
+  size_t length = (4 + n * 4 + end + 3) & ~3;
+  const uint8_t *frame = host_spi_transaction.tx_buffer;
+  if (host_spi_transaction.length != length * 8) {
+    printf("%d LEDs: %zu bits instead of %zu\n", n,
+           host_spi_transaction.length, length * 8);
+    return 1;
+  }
+
+  for (int i = 0; i < 4; i++)
+    if (frame[i] != 0)
+      errors++;
+  for (uint16_t p = 0; p < n; p++) {
+    const uint8_t *led = frame + 4 + p * 4;
+    uint8_t expected[4] = {0xE0, 0, 0, 0}; /* the first LED stays dark */
+    if (p > 0) {
+      expected[0] = 0xE0 | brightness;
+      expected[1] = 0x80 | p % 64;
+      expected[2] = p >> 8;
+      expected[3] = p;
+    }
+    for (int i = 0; i < 4; i++)
+      if (led[i] != expected[i])
+        errors++;
+  }
+  for (size_t i = 4 + n * 4; i < length; i++)
+    if (frame[i] != 0)
+      errors++;
+
+  printf("%4d LEDs, brightness %2d: %4zu bytes %s\n", n, brightness, length,
+         errors ? "FAILED" : "ok");
+  return errors;
+}
+
+static int check_clocks() {
+  const uint8_t free[] = {16, 32, 4, 12};
+  const uint8_t clock0[] = {16, 32, CONFIG_CONTROLLER_LED_SPI_CLOCK0};
+  const uint8_t clock1[] = {CONFIG_CONTROLLER_LED_SPI_CLOCK1, 32};
+
+  bool ok = spiled_driver.init(free, 4) == ESP_OK &&
+            spiled_driver.init(clock0, 3) == ESP_ERR_INVALID_ARG &&
+            spiled_driver.init(clock1, 2) == ESP_ERR_INVALID_ARG;
+  printf("clocks on LED lines refused: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main() {
+  int errors = check_clocks();
+
+  ownled_init(&simled_driver);
+  if (ownled_setProtocol(LINE, OWNLED_APA102) != ESP_OK) {
+    printf("no clocked line\n");
+    return EXIT_FAILURE;
+  }
+
+  errors += check(1, 31);
+  errors += check(15, 1);
+  errors += check(16, 17);
+  errors += check(17, 0);
+  errors += check(300, 31);
+  errors += check(1000, 8);
+
+  ownled_free();
+  return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
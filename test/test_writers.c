@@ -0,0 +1,295 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+/* LED Controller for a matrix of smart LEDs */
+/* Copyright (C) 2018-2021 Symonics GmbH, Christian Hoene */
+
+/*
+ * test_writers.c
+ *
+ * compares the line buffers written by the per color order writers with the
+ * packing of the former ownled_setPixel and ownled_setPixelW, byte by byte,
+ * for every color order, both protocols and all ways to set pixels. Then,
+ * frames redrawing some, none or all pixels are sent, and the sent buffers
+ * must hold the latest pixels.
+ */
+
+#include "ownled.c"
+#include <stdio.h>
+
+#define LINE_LONG (0)
+#define LINE_SHORT (1)
+#define PIXELS_LONG (240)
+#define PIXELS_SHORT (34) /* the BW swap of pixel 33 is beyond the end */
+#define WRITES (4000)
+#define FRAMES (40)
+
+static struct {
+  uint8_t *buffer;
+  uint32_t numBytes;
+  uint16_t numPixels;
+  uint32_t dirtyEnd;
+} reference[2];
+
+static void reference_store(uint8_t c, uint32_t o, const uint8_t *px,
+                            uint8_t n) {
+  /* the former BW swap wrote up to two bytes behind the buffer */
+  if (o + n > reference[c].numBytes)
+    return;
+  if (memcmp(reference[c].buffer + o, px, n) == 0)
+    return;
+  memcpy(reference[c].buffer + o, px, n);
+  if (o + n > reference[c].dirtyEnd)
+    reference[c].dirtyEnd = o + n;
+}
+
+/**
+ * the former ownled_setPixelW including its fall back to ownled_setPixel
+ */
+static void reference_pixel(uint8_t c, uint16_t pos, uint8_t r, uint8_t g,
+                            uint8_t b, uint8_t w) {
+  uint8_t px[RGB_BYTES_48];
+
+  if (lines[c].protocol == OWNLED_APA102) {
+    if (pos >= reference[c].numPixels)
+      return;
+    px[0] = 0xE0 | global_brightness;
+    px[1] = b;
+    px[2] = g;
+    px[3] = r;
+    reference_store(c, APA102_START + pos * APA102_LED, px, APA102_LED);
+    return;
+  }
+
+  switch (color_order) {
+  case OWNLED_BW:
+  case OWNLED_BW_FB: {
+    if (pos >= reference[c].numBytes)
+      return;
+    uint32_t o = pos;
+    switch (pos % 12) /* warum? */
+    {
+    case 6:
+    case 9:
+      o += 2;
+      break;
+    case 8:
+    case 11:
+      o -= 2;
+      break;
+    }
+    px[0] = (2126 * r + 7152 * g + 722 * b) / 10000;
+    reference_store(c, o, px, RGB_BYTES_8);
+    return;
+  }
+  case OWNLED_48:
+  case OWNLED_48_FB:
+    if (pos * RGB_BYTES_48 >= reference[c].numBytes)
+      return;
+    px[0] = lookupGamma[r] >> 8;
+    px[1] = lookupGamma[r];
+    px[2] = lookupGamma[g] >> 8;
+    px[3] = lookupGamma[g];
+    px[4] = lookupGamma[b] >> 8;
+    px[5] = lookupGamma[b];
+    reference_store(c, pos * RGB_BYTES_48, px, RGB_BYTES_48);
+    return;
+  case OWNLED_RGBW:
+  case OWNLED_GRBW:
+    if (pos * RGBW_BYTES_32 >= reference[c].numBytes)
+      return;
+    if (color_order == OWNLED_GRBW) {
+      px[0] = g;
+      px[1] = r;
+    } else {
+      px[0] = r;
+      px[1] = g;
+    }
+    px[2] = b;
+    px[3] = w;
+    reference_store(c, pos * RGBW_BYTES_32, px, RGBW_BYTES_32);
+    return;
+  default:
+    break;
+  }
+
+  if (pos * RGB_BYTES_24 >= reference[c].numBytes)
+    return;
+  switch (color_order) {
+  case OWNLED_RGB:
+  case OWNLED_RGB_FB:
+    px[0] = r;
+    px[1] = g;
+    px[2] = b;
+    break;
+  case OWNLED_RBG:
+  case OWNLED_RBG_FB:
+    px[0] = r;
+    px[1] = b;
+    px[2] = g;
+    break;
+  case OWNLED_GRB:
+  case OWNLED_GRB_FB:
+    px[0] = g;
+    px[1] = r;
+    px[2] = b;
+    break;
+  case OWNLED_GBR:
+  case OWNLED_GBR_FB:
+    px[0] = g;
+    px[1] = b;
+    px[2] = r;
+    break;
+  case OWNLED_BRG:
+  case OWNLED_BRG_FB:
+    px[0] = b;
+    px[1] = r;
+    px[2] = g;
+    break;
+  default:
+    px[0] = b;
+    px[1] = g;
+    px[2] = r;
+    break;
+  }
+  reference_store(c, pos * RGB_BYTES_24, px, RGB_BYTES_24);
+}
+
+static void reference_size(uint8_t c, uint16_t n) {
+  reference[c].numBytes = lines[c].numBytes;
+  reference[c].numPixels = n;
+  reference[c].dirtyEnd = 0;
+  free(reference[c].buffer);
+  reference[c].buffer = malloc(lines[c].numBytes);
+  memcpy(reference[c].buffer, ownled_back(c), lines[c].numBytes);
+}
+
+/**
+ * writes random pixels in one of four ways, also past the end of the lines
+ */
+static void write_pixels(uint8_t c, int how) {
+  uint16_t range = reference[c].numPixels + 8;
+  uint8_t rgbw[4 * 16];
+  uint16_t pos[16];
+
+  for (int i = 0; i < 4 * 16; i++)
+    rgbw[i] = rand();
+  uint16_t first = rand() % range;
+  uint16_t n = 1 + rand() % 16;
+
+  switch (how) {
+  case 0: /* one pixel without white */
+    ownled_setPixel(c, first, rgbw[1], rgbw[2], rgbw[0]);
+    reference_pixel(c, first, rgbw[0], rgbw[1], rgbw[2], 0);
+    break;
+  case 1: /* a span of pixels */
+    ownled_setPixels(c, NULL, first, n, rgbw, 4);
+    for (uint16_t i = 0; i < n; i++)
+      reference_pixel(c, first + i, rgbw[4 * i], rgbw[4 * i + 1],
+                      rgbw[4 * i + 2], rgbw[4 * i + 3]);
+    break;
+  case 2: /* a span of pixels in one color */
+    ownled_setPixels(c, NULL, first, n, rgbw, 0);
+    for (uint16_t i = 0; i < n; i++)
+      reference_pixel(c, first + i, rgbw[0], rgbw[1], rgbw[2], rgbw[3]);
+    break;
+  default: /* scattered pixels relative to first */
+    first = rand() % 8;
+    for (uint16_t i = 0; i < n; i++)
+      pos[i] = rand() % range;
+    ownled_setPixels(c, pos, first, n, rgbw, 4);
+    for (uint16_t i = 0; i < n; i++)
+      reference_pixel(c, first + pos[i], rgbw[4 * i], rgbw[4 * i + 1],
+                      rgbw[4 * i + 2], rgbw[4 * i + 3]);
+    break;
+  }
+}
+
+static int check(enum OWNLED_COLOR_ORDER order, enum OWNLED_PROTOCOL protocol,
+                 uint8_t brightness) {
+  const uint8_t channel[2] = {LINE_LONG, LINE_SHORT};
+  const uint16_t size[2] = {PIXELS_LONG, PIXELS_SHORT};
+  int errors = 0;
+
+  ownled_setColorOrder(order);
+  ownled_setGlobalBrightness(brightness);
+  for (int i = 0; i < 2; i++) {
+    ownled_setProtocol(channel[i], protocol);
+    ownled_setSize(channel[i], size[i]);
+    reference_size(i, size[i]);
+  }
+
+  srand(order * 2 + protocol);
+  for (int k = 0; k < WRITES; k++) {
+    int i = rand() & 1;
+    write_pixels(channel[i], rand() % 4);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    uint8_t c = channel[i];
+    const uint8_t *back = ownled_back(c);
+    for (uint32_t b = 0; b < lines[c].numBytes; b++) {
+      if (back[b] != reference[i].buffer[b]) {
+        printf("order %d protocol %d line %d byte %u: %02x instead of %02x\n",
+               order, protocol, c, b, back[b], reference[i].buffer[b]);
+        errors++;
+        break;
+      }
+    }
+    if (lines[c].dirtyEnd != reference[i].dirtyEnd) {
+      printf("order %d protocol %d line %d: dirty %u instead of %u\n", order,
+             protocol, c, lines[c].dirtyEnd, reference[i].dirtyEnd);
+      errors++;
+    }
+  }
+
+  /* the back buffers catch up with the pixels not redrawn */
+  for (int f = 0; f < FRAMES && errors == 0; f++) {
+    int i = rand() & 1;
+    if (f % 4 == 0) { /* redraw a whole line */
+      uint8_t rgbw[4 * 16];
+      for (uint16_t p = 0; p < size[i]; p += 16) {
+        uint16_t n = size[i] - p < 16 ? size[i] - p : 16;
+        for (int k = 0; k < 4 * 16; k++)
+          rgbw[k] = rand();
+        ownled_setPixels(channel[i], NULL, p, n, rgbw, 4);
+        for (uint16_t k = 0; k < n; k++)
+          reference_pixel(channel[i], p + k, rgbw[4 * k], rgbw[4 * k + 1],
+                          rgbw[4 * k + 2], rgbw[4 * k + 3]);
+      }
+    } else {
+      for (int k = rand() % 300; k > 0; k--)
+        write_pixels(channel[rand() & 1], rand() % 4);
+    }
+    if (f % 3 == 0)
+      ownled_prepare();
+
+    ownled_send();
+    while (ownled_isFinished() != ESP_OK)
+      host_advance(1000);
+    for (i = 0; i < 2; i++) {
+      uint8_t c = channel[i];
+      if (memcmp(lines[c].buffer[lines[c].front], reference[i].buffer,
+                 lines[c].numBytes)) {
+        printf("order %d protocol %d line %d: frame %d is not up to date\n",
+               order, protocol, c, f);
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+int main() {
+  int errors = 0, checks = 0;
+
+  ownled_init(&simled_driver);
+  for (int order = OWNLED_RGB; order <= OWNLED_GRBW; order++) {
+    errors += check(order, OWNLED_WS281X, 31);
+    errors += check(order, OWNLED_APA102, order % 32);
+    checks += 2;
+  }
+  ownled_free();
+
+  printf("%d color orders and protocols: %s\n", checks,
+         errors ? "FAILED" : "ok");
+  return errors ? 1 : 0;
+}